@@ -0,0 +1,156 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Profiler
+{
+	namespace
+	{
+		struct Event
+		{
+			const char *name;
+			std::uint64_t start;
+			std::uint64_t end;
+		};
+
+		//written only by its thread: an event is stored before the count is published,
+		//so the dump reads only complete events unless the ring wraps meanwhile
+		struct ThreadRing
+		{
+			std::size_t thread_id;
+			std::atomic<const char *> name;
+			std::unique_ptr<Event[]> events;
+			std::atomic<std::uint64_t> count;
+
+			ThreadRing(std::size_t _thread_id)
+				: thread_id(_thread_id),
+				  name(nullptr),
+				  events(std::make_unique<Event[]>(RING_SIZE)),
+				  count(0) {}
+		};
+
+		//rings outlive their threads, so events of finished threads are still dumped
+		struct Registry
+		{
+			std::mutex mutex;
+			std::vector<std::unique_ptr<ThreadRing>> rings;
+		};
+
+		//never destroyed, so zones may be recorded and dumped during static destruction
+		Registry & get_registry()
+		{
+			static Registry *registry = new Registry;
+			return *registry;
+		}
+
+		ThreadRing & get_thread_ring()
+		{
+			thread_local ThreadRing *ring = nullptr;
+			if(!ring)
+			{
+				Registry &registry = get_registry();
+				std::lock_guard lock(registry.mutex);
+				registry.rings.push_back(std::make_unique<ThreadRing>(registry.rings.size()));
+				ring = registry.rings.back().get();
+			}
+
+			return *ring;
+		}
+
+		void write_string(std::ostream &stream, const char *str)
+		{
+			stream<<'"';
+			for(; *str; str++)
+			{
+				if(*str == '"' || *str == '\\')
+					stream<<'\\';
+
+				stream<<*str;
+			}
+
+			stream<<'"';
+		}
+	};
+
+	void RecordZone(const char *name, std::uint64_t start, std::uint64_t end) noexcept
+	{
+		ThreadRing &ring = get_thread_ring();
+		std::uint64_t count = ring.count.load(std::memory_order_relaxed);
+		ring.events[count % RING_SIZE] = Event{.name = name, .start = start, .end = end};
+		ring.count.store(count + 1, std::memory_order_release);
+	}
+
+	void SetThreadName(const char *name) noexcept
+	{
+		get_thread_ring().name.store(name, std::memory_order_release);
+	}
+
+	void WriteChromeTrace(std::ostream &stream)
+	{
+		Registry &registry = get_registry();
+		std::lock_guard lock(registry.mutex);
+
+		//timestamps are written relative to the first recorded event
+		std::uint64_t origin = UINT64_MAX;
+		for(const auto &ring : registry.rings)
+		{
+			std::uint64_t count = ring->count.load(std::memory_order_acquire);
+			for(std::uint64_t i = (count > RING_SIZE ? count - RING_SIZE : 0); i < count; i++)
+				origin = std::min(origin, ring->events[i % RING_SIZE].start);
+		}
+
+		bool is_first = true;
+		auto separate = [&]()
+		{
+			if(!is_first)
+				stream<<",\n";
+
+			is_first = false;
+		};
+
+		stream<<"{\"traceEvents\":[\n";
+		for(const auto &ring : registry.rings)
+		{
+			if(const char *name = ring->name.load(std::memory_order_acquire))
+			{
+				separate();
+				stream<<"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"<<ring->thread_id<<",\"args\":{\"name\":";
+				write_string(stream, name);
+				stream<<"}}";
+			}
+
+			std::uint64_t count = ring->count.load(std::memory_order_acquire);
+			for(std::uint64_t i = (count > RING_SIZE ? count - RING_SIZE : 0); i < count; i++)
+			{
+				const Event &event = ring->events[i % RING_SIZE];
+				std::uint64_t start = event.start - origin;
+				std::uint64_t duration = event.end - event.start;
+
+				//complete events in microseconds with nanosecond precision
+				separate();
+				stream<<"{\"name\":";
+				write_string(stream, event.name);
+				stream<<",\"ph\":\"X\",\"pid\":0,\"tid\":"<<ring->thread_id
+					  <<",\"ts\":"<<start / 1000<<'.'<<std::setw(3)<<std::setfill('0')<<start % 1000
+					  <<",\"dur\":"<<duration / 1000<<'.'<<std::setw(3)<<std::setfill('0')<<duration % 1000<<'}';
+			}
+		}
+
+		stream<<"\n],\"displayTimeUnit\":\"ns\"}\n";
+	}
+
+	bool WriteChromeTrace(const std::filesystem::path &file_name)
+	{
+		std::ofstream file(file_name);
+		if(!file)
+			return false;
+
+		WriteChromeTrace(file);
+		return static_cast<bool>(file);
+	}
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+
+//zones are recorded only if the project is built with PROFILER_ENABLED=1,
+//otherwise PROFILER_ZONE and PROFILER_THREAD_NAME expand to nothing
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 0
+#endif
+
+namespace Profiler
+{
+	//every thread records to its own ring of RING_SIZE events, the oldest events are overwritten
+	constexpr std::size_t RING_SIZE = 1 << 14;
+
+	//nanoseconds of the steady clock
+	inline std::uint64_t GetTimestamp() noexcept
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	//name must have static storage duration(e.g. a string literal), only the pointer is stored
+	void RecordZone(const char *name, std::uint64_t start, std::uint64_t end) noexcept;
+	void SetThreadName(const char *name) noexcept;
+
+	//writes events of all threads as chrome://tracing(Perfetto) JSON.
+	//Events recorded during the dump may be torn, so it should be done while the renderer is idle
+	void WriteChromeTrace(std::ostream &stream);
+	bool WriteChromeTrace(const std::filesystem::path &file_name);
+
+	//records the lifetime of the scope as a zone of the calling thread
+	class Zone
+	{
+	public:
+		Zone(const char *_name) noexcept
+			: name(_name),
+			  start(GetTimestamp()) {}
+
+		~Zone()
+		{
+			RecordZone(name, start, GetTimestamp());
+		}
+
+		Zone(const Zone &) = delete;
+		Zone(Zone &&) = delete;
+		Zone & operator=(const Zone &) = delete;
+		Zone & operator=(Zone &&) = delete;
+
+	private:
+		const char *name;
+		std::uint64_t start;
+	};
+};
+
+#define PROFILER_CONCAT_IMPL(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_IMPL(a, b)
+
+#if PROFILER_ENABLED
+#define PROFILER_ZONE(name) ::Profiler::Zone PROFILER_CONCAT(profiler_zone_, __LINE__)(name)
+#define PROFILER_THREAD_NAME(name) ::Profiler::SetThreadName(name)
+#else
+#define PROFILER_ZONE(name)
+#define PROFILER_THREAD_NAME(name)
+#endif
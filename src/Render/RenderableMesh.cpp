@@ -1,11 +1,124 @@
 #include "RenderableMesh.h"
+#include "../Profiler/Profiler.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
 #include <cstring>
 #include <stdexcept>
 
+namespace
+{
+	//vertices which differ only in texture coordinates or normals(seams) share edges,
+	//so edges are keyed by the first vertex with the same position
+	std::vector<std::uint32_t> create_position_indices(const std::vector<MeshVertexAttribute> &vertex_attributes)
+	{
+		std::vector<std::uint32_t> position_indices(vertex_attributes.size());
+		std::map<std::array<float, 3>, std::uint32_t> positions_map;
+		for(std::uint32_t i = 0; i < vertex_attributes.size(); i++)
+		{
+			const auto &position = vertex_attributes[i].vertex;
+			auto [it, inserted] = positions_map.insert({{position[0], position[1], position[2]}, i});
+			position_indices[i] = it->second;
+		}
+
+		return position_indices;
+	}
+
+	//faces of an edge are its first two triangles(relative to indices), an edge of a single triangle repeats it
+	void append_unique_edges(const std::uint32_t *indices,
+							 std::size_t index_count,
+							 const std::vector<std::uint32_t> &position_indices,
+							 std::vector<std::uint32_t> &edge_index_data,
+							 std::vector<std::uint32_t> &edge_face_data)
+	{
+		struct Edge
+		{
+			std::uint64_t key;
+			std::uint32_t first;
+			std::uint32_t second;
+			std::uint32_t triangle;
+		};
+
+		std::vector<Edge> edges;
+		edges.reserve(index_count);
+		for(std::size_t i = 0; i + 2 < index_count; i += 3)
+			for(std::size_t j = 0; j < 3; j++)
+			{
+				std::uint32_t first = indices[i + j];
+				std::uint32_t second = indices[i + (j + 1) % 3];
+				std::uint64_t a = position_indices[first];
+				std::uint64_t b = position_indices[second];
+				if(a == b)
+					continue;
+
+				edges.push_back(Edge{.key = (std::min(a, b) << 32) | std::max(a, b),
+									 .first = first,
+									 .second = second,
+									 .triangle = static_cast<std::uint32_t>(i / 3)});
+			}
+
+		//stable sort keeps the first occurrence of every edge
+		std::stable_sort(edges.begin(), edges.end(), [](const Edge &e0, const Edge &e1)
+		{
+			return e0.key < e1.key;
+		});
+
+		for(auto it = edges.begin(); it != edges.end();)
+		{
+			auto next = std::find_if(it + 1, edges.end(), [&](const Edge &e)
+			{
+				return e.key != it->key;
+			});
+
+			edge_index_data.push_back(it->first);
+			edge_index_data.push_back(it->second);
+			edge_face_data.push_back(it->triangle);
+			edge_face_data.push_back(next - it > 1 ? (it + 1)->triangle : it->triangle);
+			it = next;
+		}
+	}
+
+	//sphere is centered at the box center, its radius reaches the farthest vertex.
+	//Bounds of a part without indices are left as they are(zero)
+	void compute_part_bounds(const std::vector<std::uint32_t> &indices,
+							 const std::vector<MeshVertexAttribute> &vertex_attributes,
+							 RenderablePart &part)
+	{
+		if(indices.empty())
+			return;
+
+		part.aabb_min = vertex_attributes[indices[0]].vertex;
+		part.aabb_max = part.aabb_min;
+		for(auto index : indices)
+		{
+			const auto &position = vertex_attributes[index].vertex;
+			for(std::size_t i = 0; i < 3; i++)
+			{
+				part.aabb_min[i] = std::min(part.aabb_min[i], position[i]);
+				part.aabb_max[i] = std::max(part.aabb_max[i], position[i]);
+			}
+		}
+
+		part.sphere_center = (part.aabb_min + part.aabb_max) * 0.5f;
+		float max_square_distance = 0.0f;
+		for(auto index : indices)
+		{
+			auto offset = vertex_attributes[index].vertex - part.sphere_center;
+			max_square_distance = std::max(max_square_distance, offset * offset);
+		}
+
+		part.sphere_radius = std::sqrt(max_square_distance);
+	}
+};
+
 
 RenderableMesh::RenderableMesh(RenderableMesh &&rm) noexcept
 	: vertex_data(std::move(rm.vertex_data)),
 	  index_data(std::move(rm.index_data)),
+	  edge_index_data(std::move(rm.edge_index_data)),
+	  edge_face_data(std::move(rm.edge_face_data)),
+	  meshlet_data(std::move(rm.meshlet_data)),
 	  parts(std::move(rm.parts)) {}
 
 RenderableMesh & RenderableMesh::operator=(RenderableMesh &&rm) noexcept
@@ -14,6 +127,9 @@ RenderableMesh & RenderableMesh::operator=(RenderableMesh &&rm) noexcept
 
 	vertex_data = std::move(rm.vertex_data);
 	index_data = std::move(rm.index_data);
+	edge_index_data = std::move(rm.edge_index_data);
+	edge_face_data = std::move(rm.edge_face_data);
+	meshlet_data = std::move(rm.meshlet_data);
 	parts = std::move(rm.parts);
 
 	return *this;
@@ -22,6 +138,7 @@ RenderableMesh & RenderableMesh::operator=(RenderableMesh &&rm) noexcept
 void RenderableMesh::Create(const MeshVertexIndexData &data/*,
 							const std::map<MaterialTreeKey, std::unique_ptr<Material>> &materials*/)
 {
+	PROFILER_ZONE("RenderableMesh::Create");
 	std::vector<std::byte> _vertex_data(data.vertex_attributes.size() * sizeof(MeshVertexAttribute));
 	std::memcpy(_vertex_data.data(), data.vertex_attributes.data(), _vertex_data.size());
 
@@ -34,20 +151,54 @@ void RenderableMesh::Create(const MeshVertexIndexData &data/*,
 		common_indices_size += ind.indices.size();
 
 	std::vector<std::uint32_t> _index_data(common_indices_size);
+	std::vector<std::uint32_t> _edge_index_data;
+	std::vector<std::uint32_t> _edge_face_data;
+	std::vector<Renderer::Meshlet> _meshlet_data;
+	std::vector<std::uint32_t> position_indices = create_position_indices(data.vertex_attributes);
 
 	std::size_t offset = 0;
 	for(const auto &ind : data.part_indices)
 	{
-		_parts.push_back(RenderablePart{.count = ind.indices.size(),
-										.offset = offset/*,
+		//triangles of the part are stored in the meshlet order, indices of an incomplete last triangle are dropped
+		std::size_t meshlet_offset = _meshlet_data.size();
+		std::size_t meshlet_index_count = ind.indices.size() - ind.indices.size() % 3;
+		Renderer::BuildMeshlets(_vertex_data.data(),
+								sizeof(MeshVertexAttribute),
+								offsetof(MeshVertexAttribute, vertex),
+								ind.indices.data(),
+								ind.indices.size(),
+								_index_data.data() + offset,
+								_meshlet_data);
+
+		//edge faces index the stored(meshlet ordered) triangles of the part
+		std::size_t edge_offset = _edge_index_data.size();
+		append_unique_edges(_index_data.data() + offset,
+							meshlet_index_count,
+							position_indices,
+							_edge_index_data,
+							_edge_face_data);
+
+		_parts.push_back(RenderablePart{.count = meshlet_index_count,
+										.offset = offset,
+										.edge_count = _edge_index_data.size() - edge_offset,
+										.edge_offset = edge_offset,
+										.meshlet_count = _meshlet_data.size() - meshlet_offset,
+										.meshlet_offset = meshlet_offset,
+										.aabb_min = hrs::math::glsl::vec3(0.0f, 0.0f, 0.0f),
+										.aabb_max = hrs::math::glsl::vec3(0.0f, 0.0f, 0.0f),
+										.sphere_center = hrs::math::glsl::vec3(0.0f, 0.0f, 0.0f),
+										.sphere_radius = 0.0f/*,
 										.material = materials.find(MaterialTreeKey(ind.material_lib_name, ind.material_name))->second.get()*/});
+		compute_part_bounds(ind.indices, data.vertex_attributes, _parts.back());
 
-		std::memcpy(_index_data.data() + offset, ind.indices.data(), ind.indices.size() * 4);
 		offset += ind.indices.size();
 	}
 
 	vertex_data = std::move(_vertex_data);
 	index_data = std::move(_index_data);
+	edge_index_data = std::move(_edge_index_data);
+	edge_face_data = std::move(_edge_face_data);
+	meshlet_data = std::move(_meshlet_data);
 	parts = std::move(_parts);
 }
 
@@ -64,3 +215,18 @@ const std::vector<std::uint32_t> & RenderableMesh::GetIndexData() const noexcept
 {
 	return index_data;
 }
+
+const std::vector<std::uint32_t> & RenderableMesh::GetEdgeIndexData() const noexcept
+{
+	return edge_index_data;
+}
+
+const std::vector<std::uint32_t> & RenderableMesh::GetEdgeFaceData() const noexcept
+{
+	return edge_face_data;
+}
+
+const std::vector<Renderer::Meshlet> & RenderableMesh::GetMeshletData() const noexcept
+{
+	return meshlet_data;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Wavefront/Mesh.h"
+#include "../RendererBackend/Meshlet.h"
 //#include "../Material/Material.h"
 #include <vector>
 #include <map>
@@ -9,6 +10,18 @@ struct RenderablePart
 {
 	std::size_t count;
 	std::size_t offset;
+	//unique edges of the part: pairs of indices in the edge index data,
+	//their faces are at the same offset in the edge face data
+	std::size_t edge_count;//count of indices(two per edge)
+	std::size_t edge_offset;
+	//meshlets of the part in the meshlet data, their index offsets are relative to the part offset
+	std::size_t meshlet_count;
+	std::size_t meshlet_offset;
+	//bounding volumes of the referenced vertex positions in the model space
+	hrs::math::glsl::vec3 aabb_min;
+	hrs::math::glsl::vec3 aabb_max;
+	hrs::math::glsl::vec3 sphere_center;
+	float sphere_radius;
 	//const Material *material;
 };
 
@@ -28,9 +41,17 @@ public:
 
 	const std::vector<std::byte> & GetVertexData() const noexcept;
 	const std::vector<std::uint32_t> & GetIndexData() const noexcept;
+	//line list with every edge shared by triangles of a part stored once(for wireframe drawing)
+	const std::vector<std::uint32_t> & GetEdgeIndexData() const noexcept;
+	//two triangles adjacent to every edge(see Renderer::LineFaceData), indices of the triangles are relative to the part
+	const std::vector<std::uint32_t> & GetEdgeFaceData() const noexcept;
+	const std::vector<Renderer::Meshlet> & GetMeshletData() const noexcept;
 
 private:
 	std::vector<std::byte> vertex_data;
 	std::vector<std::uint32_t> index_data;
+	std::vector<std::uint32_t> edge_index_data;
+	std::vector<std::uint32_t> edge_face_data;
+	std::vector<Renderer::Meshlet> meshlet_data;
 	std::vector<RenderablePart> parts;
 };
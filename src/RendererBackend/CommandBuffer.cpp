@@ -0,0 +1,129 @@
+#include "CommandBuffer.h"
+#include "../Profiler/Profiler.h"
+#include <algorithm>
+
+namespace Renderer
+{
+	CommandBuffer::CommandBuffer(CommandBuffer &&cb) noexcept
+		: states(std::move(cb.states)),
+		  commands(std::move(cb.commands)) {}
+
+	CommandBuffer & CommandBuffer::operator=(CommandBuffer &&cb) noexcept
+	{
+		states = std::move(cb.states);
+		commands = std::move(cb.commands);
+
+		return *this;
+	}
+
+	void CommandBuffer::Reset() noexcept
+	{
+		states.clear();
+		commands.clear();
+	}
+
+	bool CommandBuffer::IsEmpty() const noexcept
+	{
+		return commands.empty();
+	}
+
+	void CommandBuffer::ClearImage(const ClearValue &value, std::size_t index)
+	{
+		record(nullptr,
+			   {},
+			   false,
+			   [value, index](Framebuffer &fb, const State &/*state*/)
+			   {
+				   fb.ClearImage(value, index);
+			   });
+	}
+
+	void CommandBuffer::ClearDepthImage(float value)
+	{
+		record(nullptr,
+			   {},
+			   false,
+			   [value](Framebuffer &fb, const State &/*state*/)
+			   {
+				   fb.ClearDepthImage(value);
+			   });
+	}
+
+	void CommandBuffer::ResolveImage(std::size_t index, Image &destination)
+	{
+		record(nullptr,
+			   {},
+			   false,
+			   [index, &destination](Framebuffer &fb, const State &/*state*/)
+			   {
+				   fb.ResolveImage(index, destination);
+			   });
+	}
+
+	void CommandBuffer::SetState(const State &state)
+	{
+		states.push_back(state);
+	}
+
+	void CommandBuffer::Execute(Framebuffer &fb, CommandSortMode sort_mode) const
+	{
+		PROFILER_ZONE("CommandBuffer::Execute");
+		//recorded commands are left untouched, so the buffer may be executed again with another sort mode
+		std::vector<std::size_t> order(commands.size());
+		for(std::size_t i = 0; i < order.size(); i++)
+			order[i] = i;
+
+		if(sort_mode != CommandSortMode::None)
+			sort_draws(order, sort_mode);
+
+		for(auto index : order)
+		{
+			const Command &command = commands[index];
+			command.function(fb, states[command.state_index]);
+		}
+	}
+
+	void CommandBuffer::record(const void *pipeline,
+							   const DrawSortKey &sort_key,
+							   bool is_draw,
+							   CommandFunction &&function)
+	{
+		if(states.empty())
+			states.push_back(State{});
+
+		commands.push_back(Command{.function = std::move(function),
+								   .is_draw = is_draw,
+								   .state_index = states.size() - 1,
+								   .pipeline = pipeline,
+								   .sort_key = sort_key});
+	}
+
+	void CommandBuffer::sort_draws(std::vector<std::size_t> &order, CommandSortMode sort_mode) const
+	{
+		auto is_less = [&](std::size_t a, std::size_t b) noexcept
+		{
+			const Command &command_a = commands[a];
+			const Command &command_b = commands[b];
+			if(sort_mode == CommandSortMode::FrontToBack)
+				return command_a.sort_key.depth < command_b.sort_key.depth;
+
+			if(command_a.pipeline != command_b.pipeline)
+				return std::less<const void *>{}(command_a.pipeline, command_b.pipeline);
+
+			return command_a.sort_key.material < command_b.sort_key.material;
+		};
+
+		//stable sort of every run of draws between other commands keeps the recorded order of equal keys
+		auto run_begin = order.begin();
+		while(run_begin != order.end())
+		{
+			auto run_end = std::find_if(run_begin, order.end(), [this](std::size_t index) noexcept
+			{
+				return !commands[index].is_draw;
+			});
+
+			std::stable_sort(run_begin, run_end, is_less);
+			run_begin = (run_end == order.end() ? run_end : std::next(run_end));
+		}
+	}
+};
@@ -0,0 +1,277 @@
+#pragma once
+
+#include "Pipeline.hpp"
+#include <functional>
+#include <vector>
+
+namespace Renderer
+{
+	enum class CommandSortMode
+	{
+		None,//recorded order
+		PipelineMaterial,//draws of the same pipeline and material are executed together
+		FrontToBack//draws are executed by increasing sort depth
+	};
+
+	struct DrawSortKey
+	{
+		std::uint64_t material;
+		float depth;//e.g. view space distance of the object
+	};
+
+	//records clears, state changes and draws to be executed against a framebuffer later.
+	//Shader data is copied on record, vertex, index and instance data are referenced
+	//and must stay valid until the execution is finished.
+	//Draws are sorted only between clears, resolves and queries, which keep their recorded position
+	class CommandBuffer
+	{
+	public:
+		CommandBuffer() = default;
+		~CommandBuffer() = default;
+		CommandBuffer(const CommandBuffer &) = delete;
+		CommandBuffer(CommandBuffer &&cb) noexcept;
+		CommandBuffer & operator=(const CommandBuffer &) = delete;
+		CommandBuffer & operator=(CommandBuffer &&cb) noexcept;
+
+		void Reset() noexcept;
+		bool IsEmpty() const noexcept;
+
+		void ClearImage(const ClearValue &value, std::size_t index);
+		void ClearDepthImage(float value);
+		//destination must stay valid until the execution is finished
+		void ResolveImage(std::size_t index, Image &destination);
+
+		//state is used by all following draws, default state is used before the first call
+		void SetState(const State &state);
+
+		template<typename P, typename SD>
+		void Draw(P &pipeline,
+				  const std::byte *vertex_data,
+				  std::size_t count,
+				  const SD &shader_data,
+				  const DrawSortKey &sort_key = {});
+
+		template<typename P, typename SD>
+		void DrawIndexed(P &pipeline,
+						 const std::byte *vertex_data,
+						 const std::uint32_t *index_data,
+						 std::size_t count,
+						 const SD &shader_data,
+						 const DrawSortKey &sort_key = {});
+
+		template<typename P, typename SD>
+		void DrawIndexedInstanced(P &pipeline,
+								  const std::byte *vertex_data,
+								  const std::uint32_t *index_data,
+								  std::size_t count,
+								  const std::byte *instance_data,
+								  std::size_t instance_data_stride,
+								  std::uint32_t instance_count,
+								  const SD &shader_data,
+								  const DrawSortKey &sort_key = {});
+
+		template<typename P, typename SD>
+		void DrawIndexedLines(P &pipeline,
+							  const std::byte *vertex_data,
+							  const std::uint32_t *index_data,
+							  std::size_t count,
+							  const SD &shader_data,
+							  const DrawSortKey &sort_key = {});
+
+		//face data is referenced like index data
+		template<typename P, typename SD>
+		void DrawIndexedLines(P &pipeline,
+							  const std::byte *vertex_data,
+							  const std::uint32_t *index_data,
+							  std::size_t count,
+							  const LineFaceData &face_data,
+							  const SD &shader_data,
+							  const DrawSortKey &sort_key = {});
+
+		//meshlets are referenced like vertex and index data, cull data is copied
+		template<typename P, typename SD>
+		void DrawIndexedMeshlets(P &pipeline,
+								 const std::byte *vertex_data,
+								 const std::uint32_t *index_data,
+								 const Meshlet *meshlets,
+								 std::size_t meshlet_count,
+								 const MeshletCullData &cull_data,
+								 const SD &shader_data,
+								 const DrawSortKey &sort_key = {});
+
+		//draws of the pipeline between begin and end are counted by the query.
+		//Both commands keep their recorded position, so sorting never moves draws in or out of a query
+		template<typename P>
+		void BeginOcclusionQuery(P &pipeline, OcclusionQuery &query);
+
+		template<typename P>
+		void EndOcclusionQuery(P &pipeline);
+
+		//executes commands on the calling thread
+		void Execute(Framebuffer &fb, CommandSortMode sort_mode = CommandSortMode::None) const;
+
+	private:
+		using CommandFunction = std::function<void (Framebuffer &fb, const State &state)>;
+
+		struct Command
+		{
+			CommandFunction function;
+			bool is_draw;//clears and resolves are never reordered
+			std::size_t state_index;
+			const void *pipeline;
+			DrawSortKey sort_key;
+		};
+
+		void record(const void *pipeline, const DrawSortKey &sort_key, bool is_draw, CommandFunction &&function);
+		void sort_draws(std::vector<std::size_t> &order, CommandSortMode sort_mode) const;
+
+		std::vector<State> states;
+		std::vector<Command> commands;
+	};
+
+	template<typename P, typename SD>
+	void CommandBuffer::Draw(P &pipeline,
+							 const std::byte *vertex_data,
+							 std::size_t count,
+							 const SD &shader_data,
+							 const DrawSortKey &sort_key)
+	{
+		record(&pipeline,
+			   sort_key,
+			   true,
+			   [&pipeline, vertex_data, count, shader_data = SD(shader_data)](Framebuffer &fb, const State &state) mutable
+			   {
+				   pipeline.Draw(fb, vertex_data, count, state, shader_data);
+			   });
+	}
+
+	template<typename P, typename SD>
+	void CommandBuffer::DrawIndexed(P &pipeline,
+									const std::byte *vertex_data,
+									const std::uint32_t *index_data,
+									std::size_t count,
+									const SD &shader_data,
+									const DrawSortKey &sort_key)
+	{
+		record(&pipeline,
+			   sort_key,
+			   true,
+			   [&pipeline, vertex_data, index_data, count, shader_data = SD(shader_data)](Framebuffer &fb, const State &state) mutable
+			   {
+				   pipeline.DrawIndexed(fb, vertex_data, index_data, count, state, shader_data);
+			   });
+	}
+
+	template<typename P, typename SD>
+	void CommandBuffer::DrawIndexedInstanced(P &pipeline,
+											 const std::byte *vertex_data,
+											 const std::uint32_t *index_data,
+											 std::size_t count,
+											 const std::byte *instance_data,
+											 std::size_t instance_data_stride,
+											 std::uint32_t instance_count,
+											 const SD &shader_data,
+											 const DrawSortKey &sort_key)
+	{
+		record(&pipeline,
+			   sort_key,
+			   true,
+			   [&pipeline,
+				vertex_data,
+				index_data,
+				count,
+				instance_data,
+				instance_data_stride,
+				instance_count,
+				shader_data = SD(shader_data)](Framebuffer &fb, const State &state) mutable
+			   {
+				   pipeline.DrawIndexedInstanced(fb,
+												 vertex_data,
+												 index_data,
+												 count,
+												 instance_data,
+												 instance_data_stride,
+												 instance_count,
+												 state,
+												 shader_data);
+			   });
+	}
+
+	template<typename P, typename SD>
+	void CommandBuffer::DrawIndexedLines(P &pipeline,
+										 const std::byte *vertex_data,
+										 const std::uint32_t *index_data,
+										 std::size_t count,
+										 const SD &shader_data,
+										 const DrawSortKey &sort_key)
+	{
+		record(&pipeline,
+			   sort_key,
+			   true,
+			   [&pipeline, vertex_data, index_data, count, shader_data = SD(shader_data)](Framebuffer &fb, const State &state) mutable
+			   {
+				   pipeline.DrawIndexedLines(fb, vertex_data, index_data, count, state, shader_data);
+			   });
+	}
+
+	template<typename P, typename SD>
+	void CommandBuffer::DrawIndexedLines(P &pipeline,
+										 const std::byte *vertex_data,
+										 const std::uint32_t *index_data,
+										 std::size_t count,
+										 const LineFaceData &face_data,
+										 const SD &shader_data,
+										 const DrawSortKey &sort_key)
+	{
+		record(&pipeline,
+			   sort_key,
+			   true,
+			   [&pipeline, vertex_data, index_data, count, face_data, shader_data = SD(shader_data)](Framebuffer &fb, const State &state) mutable
+			   {
+				   pipeline.DrawIndexedLines(fb, vertex_data, index_data, count, face_data, state, shader_data);
+			   });
+	}
+
+	template<typename P, typename SD>
+	void CommandBuffer::DrawIndexedMeshlets(P &pipeline,
+											const std::byte *vertex_data,
+											const std::uint32_t *index_data,
+											const Meshlet *meshlets,
+											std::size_t meshlet_count,
+											const MeshletCullData &cull_data,
+											const SD &shader_data,
+											const DrawSortKey &sort_key)
+	{
+		record(&pipeline,
+			   sort_key,
+			   true,
+			   [&pipeline, vertex_data, index_data, meshlets, meshlet_count, cull_data, shader_data = SD(shader_data)](Framebuffer &fb, const State &state) mutable
+			   {
+				   pipeline.DrawIndexedMeshlets(fb, vertex_data, index_data, meshlets, meshlet_count, cull_data, state, shader_data);
+			   });
+	}
+
+	template<typename P>
+	void CommandBuffer::BeginOcclusionQuery(P &pipeline, OcclusionQuery &query)
+	{
+		record(&pipeline,
+			   {},
+			   false,
+			   [&pipeline, &query](Framebuffer &/*fb*/, const State &/*state*/)
+			   {
+				   pipeline.BeginOcclusionQuery(query);
+			   });
+	}
+
+	template<typename P>
+	void CommandBuffer::EndOcclusionQuery(P &pipeline)
+	{
+		record(&pipeline,
+			   {},
+			   false,
+			   [&pipeline](Framebuffer &/*fb*/, const State &/*state*/)
+			   {
+				   pipeline.EndOcclusionQuery();
+			   });
+	}
+};
@@ -0,0 +1,89 @@
+#include "CommandQueue.h"
+#include "../Profiler/Profiler.h"
+
+namespace Renderer
+{
+	Fence::Fence(std::shared_future<void> &&_future) noexcept
+		: future(std::move(_future)) {}
+
+	bool Fence::IsCreated() const noexcept
+	{
+		return future.valid();
+	}
+
+	bool Fence::IsSignaled() const
+	{
+		if(!future.valid())
+			return true;
+
+		return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	void Fence::Wait() const
+	{
+		if(future.valid())
+			future.get();
+	}
+
+	CommandQueue::CommandQueue()
+		: is_stopping(false)
+	{
+		worker = std::thread(&CommandQueue::worker_loop, this);
+	}
+
+	CommandQueue::~CommandQueue()
+	{
+		{
+			std::lock_guard lock(mutex);
+			is_stopping = true;
+		}
+
+		submit_cv.notify_one();
+		worker.join();
+	}
+
+	Fence CommandQueue::Submit(const CommandBuffer &command_buffer, Framebuffer &fb, CommandSortMode sort_mode)
+	{
+		std::promise<void> promise;
+		Fence fence(promise.get_future().share());
+		{
+			std::lock_guard lock(mutex);
+			submissions.push_back(Submission{.command_buffer = &command_buffer,
+											 .framebuffer = &fb,
+											 .sort_mode = sort_mode,
+											 .promise = std::move(promise)});
+		}
+
+		submit_cv.notify_one();
+		return fence;
+	}
+
+	void CommandQueue::worker_loop()
+	{
+		PROFILER_THREAD_NAME("CommandQueue");
+		while(true)
+		{
+			Submission submission;
+			{
+				std::unique_lock lock(mutex);
+				submit_cv.wait(lock, [this]{ return is_stopping || !submissions.empty(); });
+				//pending submissions are executed before stopping
+				if(submissions.empty())
+					return;
+
+				submission = std::move(submissions.front());
+				submissions.pop_front();
+			}
+
+			try
+			{
+				submission.command_buffer->Execute(*submission.framebuffer, submission.sort_mode);
+				submission.promise.set_value();
+			}
+			catch(...)
+			{
+				submission.promise.set_exception(std::current_exception());
+			}
+		}
+	}
+};
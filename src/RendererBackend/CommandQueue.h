@@ -0,0 +1,72 @@
+#pragma once
+
+#include "CommandBuffer.h"
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+namespace Renderer
+{
+	//signaled when execution of a submitted command buffer is finished
+	class Fence
+	{
+	public:
+		Fence() = default;
+		~Fence() = default;
+		Fence(const Fence &) = default;
+		Fence(Fence &&) = default;
+		Fence & operator=(const Fence &) = default;
+		Fence & operator=(Fence &&) = default;
+
+		bool IsCreated() const noexcept;
+		bool IsSignaled() const;
+
+		//blocks until the fence is signaled, rethrows exception thrown by the execution
+		void Wait() const;
+
+	private:
+		friend class CommandQueue;
+
+		Fence(std::shared_future<void> &&_future) noexcept;
+
+		std::shared_future<void> future;
+	};
+
+	//executes submitted command buffers one by one in submission order on its own thread,
+	//so the caller may record the next frame meanwhile.
+	//Pipelines of the command buffer still use their thread pools for the draws
+	class CommandQueue
+	{
+	public:
+		CommandQueue();
+		//waits for all submitted command buffers
+		~CommandQueue();
+		CommandQueue(const CommandQueue &) = delete;
+		CommandQueue(CommandQueue &&) = delete;
+		CommandQueue & operator=(const CommandQueue &) = delete;
+		CommandQueue & operator=(CommandQueue &&) = delete;
+
+		//command buffer, framebuffer and data referenced by the draws must stay unchanged until the fence is signaled.
+		//Pipelines of the command buffer must not be used by other threads meanwhile
+		Fence Submit(const CommandBuffer &command_buffer, Framebuffer &fb, CommandSortMode sort_mode = CommandSortMode::None);
+
+	private:
+		struct Submission
+		{
+			const CommandBuffer *command_buffer;
+			Framebuffer *framebuffer;
+			CommandSortMode sort_mode;
+			std::promise<void> promise;
+		};
+
+		void worker_loop();
+
+		std::mutex mutex;
+		std::condition_variable submit_cv;
+		std::deque<Submission> submissions;
+		bool is_stopping;
+		std::thread worker;
+	};
+};
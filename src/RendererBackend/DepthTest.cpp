@@ -0,0 +1,83 @@
+#include "DepthTest.h"
+
+namespace Renderer
+{
+	namespace
+	{
+		template<CompareOp OP, Format FORMAT>
+		bool depth_test(const std::byte *texel, float depth) noexcept
+		{
+			return CompareDepth(OP, GetDepthCompareValue<FORMAT>(depth), LoadDepthCompareValue<FORMAT>(texel));
+		}
+
+		template<Format FORMAT>
+		void depth_write(std::byte *texel, float depth) noexcept
+		{
+			SetFormatImageDepth(FORMAT, texel, depth);
+		}
+
+		template<Format FORMAT>
+		DepthTestFunction get_depth_test_function(CompareOp op) noexcept
+		{
+			switch(op)
+			{
+				case CompareOp::Never:
+					return depth_test<CompareOp::Never, FORMAT>;
+					break;
+				case CompareOp::Less:
+					return depth_test<CompareOp::Less, FORMAT>;
+					break;
+				case CompareOp::Equal:
+					return depth_test<CompareOp::Equal, FORMAT>;
+					break;
+				case CompareOp::LessOrEqual:
+					return depth_test<CompareOp::LessOrEqual, FORMAT>;
+					break;
+				case CompareOp::Greater:
+					return depth_test<CompareOp::Greater, FORMAT>;
+					break;
+				case CompareOp::NotEqual:
+					return depth_test<CompareOp::NotEqual, FORMAT>;
+					break;
+				case CompareOp::GreaterOrEqual:
+					return depth_test<CompareOp::GreaterOrEqual, FORMAT>;
+					break;
+				default:
+					return depth_test<CompareOp::Always, FORMAT>;
+					break;
+			}
+		}
+	};
+
+	DepthTestFunction GetDepthTestFunction(CompareOp op, Format format) noexcept
+	{
+		switch(format)
+		{
+			case Format::DEPTH16_UNORM:
+				return get_depth_test_function<Format::DEPTH16_UNORM>(op);
+				break;
+			case Format::DEPTH24_UNORM:
+				return get_depth_test_function<Format::DEPTH24_UNORM>(op);
+				break;
+			default:
+				return get_depth_test_function<Format::DEPTH32_SFLOAT>(op);
+				break;
+		}
+	}
+
+	DepthWriteFunction GetDepthWriteFunction(Format format) noexcept
+	{
+		switch(format)
+		{
+			case Format::DEPTH16_UNORM:
+				return depth_write<Format::DEPTH16_UNORM>;
+				break;
+			case Format::DEPTH24_UNORM:
+				return depth_write<Format::DEPTH24_UNORM>;
+				break;
+			default:
+				return depth_write<Format::DEPTH32_SFLOAT>;
+				break;
+		}
+	}
+};
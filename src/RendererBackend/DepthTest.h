@@ -0,0 +1,154 @@
+#pragma once
+
+#include "Image.h"
+#include <cstddef>
+
+namespace Renderer
+{
+	//fragment passes if "fragment_depth op stored_depth" is true.
+	//Reversed z(near plane at 1, far plane at 0) uses Greater/GreaterOrEqual and clears depth to 0
+	enum class CompareOp
+	{
+		Never,
+		Less,
+		Equal,
+		LessOrEqual,
+		Greater,
+		NotEqual,
+		GreaterOrEqual,
+		Always
+	};
+
+	//comparisons with NaN fail except NotEqual
+	constexpr bool CompareDepth(CompareOp op, float depth, float stored_depth) noexcept
+	{
+		switch(op)
+		{
+			case CompareOp::Never:
+				return false;
+				break;
+			case CompareOp::Less:
+				return depth < stored_depth;
+				break;
+			case CompareOp::Equal:
+				return depth == stored_depth;
+				break;
+			case CompareOp::LessOrEqual:
+				return depth <= stored_depth;
+				break;
+			case CompareOp::Greater:
+				return depth > stored_depth;
+				break;
+			case CompareOp::NotEqual:
+				return depth != stored_depth;
+				break;
+			case CompareOp::GreaterOrEqual:
+				return depth >= stored_depth;
+				break;
+			case CompareOp::Always:
+				return true;
+				break;
+		}
+
+		return false;
+	}
+
+	//hierarchical z: [min_depth, max_depth] is the depth range of a primitive and [bounds_min, bounds_max]
+	//is the range of stored depths of a block, both as stored by the depth format(see QuantizeFormatDepth).
+	//Rejected if no fragment of the primitive can pass the test, NaN bounds are never rejected
+	constexpr bool IsDepthRangeRejected(CompareOp op,
+										float min_depth,
+										float max_depth,
+										float bounds_min,
+										float bounds_max) noexcept
+	{
+		switch(op)
+		{
+			case CompareOp::Never:
+				return true;
+				break;
+			case CompareOp::Less:
+				return min_depth >= bounds_max;
+				break;
+			case CompareOp::Equal:
+				return max_depth < bounds_min || min_depth > bounds_max;
+				break;
+			case CompareOp::LessOrEqual:
+				return min_depth > bounds_max;
+				break;
+			case CompareOp::Greater:
+				return max_depth <= bounds_min;
+				break;
+			case CompareOp::GreaterOrEqual:
+				return max_depth < bounds_min;
+				break;
+			default:
+				return false;
+				break;
+		}
+	}
+
+	//accepted if every fragment of the primitive passes the test, NaN bounds are never accepted
+	constexpr bool IsDepthRangeAccepted(CompareOp op,
+										float min_depth,
+										float max_depth,
+										float bounds_min,
+										float bounds_max) noexcept
+	{
+		switch(op)
+		{
+			case CompareOp::Less:
+				return max_depth < bounds_min;
+				break;
+			case CompareOp::LessOrEqual:
+				return max_depth <= bounds_min;
+				break;
+			case CompareOp::Greater:
+				return min_depth > bounds_max;
+				break;
+			case CompareOp::NotEqual:
+				return max_depth < bounds_min || min_depth > bounds_max;
+				break;
+			case CompareOp::GreaterOrEqual:
+				return min_depth >= bounds_max;
+				break;
+			case CompareOp::Always:
+				return true;
+				break;
+			default:
+				return false;
+				break;
+		}
+	}
+
+	//unorm depths are compared by their codes, which are exact in float,
+	//so depth written by a fragment is equal to its own test value
+	template<Format FORMAT>
+	constexpr float GetDepthCompareValue(float depth) noexcept
+	{
+		if constexpr(FORMAT == Format::DEPTH32_SFLOAT)
+			return depth;
+		else
+			return static_cast<float>(EncodeUnormDepth(depth, GetFormatDepthUnormScale(FORMAT)));
+	}
+
+	template<Format FORMAT>
+	constexpr float LoadDepthCompareValue(const std::byte *texel) noexcept
+	{
+		if constexpr(FORMAT == Format::DEPTH32_SFLOAT)
+			return *reinterpret_cast<const float *>(texel);
+		else if constexpr(FORMAT == Format::DEPTH16_UNORM)
+			return static_cast<float>(*reinterpret_cast<const std::uint16_t *>(texel));
+		else
+			return static_cast<float>(*reinterpret_cast<const std::uint32_t *>(texel) & 0xFFFFFF);
+	}
+
+	//tests depth against the texel of the depth format, specialized for the compare op and the format
+	using DepthTestFunction = bool (*)(const std::byte *texel, float depth) noexcept;
+	//writes depth to the texel of the depth format
+	using DepthWriteFunction = void (*)(std::byte *texel, float depth) noexcept;
+
+	//format must be a depth format
+	DepthTestFunction GetDepthTestFunction(CompareOp op, Format format) noexcept;
+	DepthWriteFunction GetDepthWriteFunction(Format format) noexcept;
+};
@@ -1,9 +1,19 @@
 #include "Framebuffer.h"
+#include "../Profiler/Profiler.h"
 #include <execution>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace Renderer
 {
 	Framebuffer::Framebuffer(std::span<Image *> _color_images, Image * _depth_image)
+		: depth_bounds_image_width(0),
+		  depth_bounds_image_height(0)
 	{
 		if(!_color_images.empty())
 		{
@@ -22,6 +32,10 @@ namespace Renderer
 
 		color_images.clear();
 		depth_image = nullptr;
+		depth_bounds.clear();
+		depth_bounds_dirty.clear();
+		depth_bounds_image_width = 0;
+		depth_bounds_image_height = 0;
 	}
 
 	bool Framebuffer::IsCreated() const noexcept
@@ -31,6 +45,7 @@ namespace Renderer
 
 	void Framebuffer::ClearImage(const ClearValue &value, std::size_t index)
 	{
+		PROFILER_ZONE("ClearImage");
 		if(index >= color_images.size())
 			return;
 
@@ -38,30 +53,106 @@ namespace Renderer
 		if(!image)
 			return;
 
-		if(image->GetFormat() == Format::DEPTH32_SFLOAT)
-		{
-			float depth = value.depth;
-			for(std::size_t i = 0; i < image->GetWidth(); i++)
-				for(std::size_t j = 0; j < image->GetHeight(); j++)
-					image->SetValueDepth(i, j, depth);
-		}
+		std::size_t texel_count = image->GetWidth() * image->GetHeight() * image->GetSampleCount();
+		if(texel_count == 0)
+			return;
+
+		//the first texel is encoded once and copied to the rest with doubling copies
+		std::byte *data = image->GetMappedPtr();
+		std::size_t texel_size = GetFormatTexelSize(image->GetFormat());
+		if(IsDepthFormat(image->GetFormat()))
+			SetFormatImageDepth(image->GetFormat(), data, value.depth);
 		else
-		{
-			const hrs::math::glsl::vec4 &color = value.color;
-			for(std::size_t i = 0; i < image->GetWidth(); i++)
-				for(std::size_t j = 0; j < image->GetHeight(); j++)
-					image->SetValueColor(i, j, color);
-		}
+			SetFormatImageColor(image->GetFormat(), data, value.color);
+
+		for(std::size_t filled = 1; filled < texel_count; filled *= 2)
+			std::memcpy(data + filled * texel_size, data, std::min(filled, texel_count - filled) * texel_size);
 	}
 
 	void Framebuffer::ClearDepthImage(float value)
 	{
+		PROFILER_ZONE("ClearDepthImage");
 		if(!depth_image)
 			return;
 
-		for(std::size_t i = 0; i < depth_image->GetWidth(); i++)
-			for(std::size_t j = 0; j < depth_image->GetHeight(); j++)
-				depth_image->SetValueDepth(i, j, value);
+		std::size_t texel_count = depth_image->GetWidth() * depth_image->GetHeight() * depth_image->GetSampleCount();
+		if(texel_count != 0)
+		{
+			std::byte *data = depth_image->GetMappedPtr();
+			std::size_t texel_size = GetFormatTexelSize(depth_image->GetFormat());
+			SetFormatImageDepth(depth_image->GetFormat(), data, value);
+			for(std::size_t filled = 1; filled < texel_count; filled *= 2)
+				std::memcpy(data + filled * texel_size, data, std::min(filled, texel_count - filled) * texel_size);
+		}
+
+		//bounds hold depth as it is stored by the format
+		float stored_value = QuantizeFormatDepth(depth_image->GetFormat(), value);
+		depth_bounds_image_width = depth_image->GetWidth();
+		depth_bounds_image_height = depth_image->GetHeight();
+		depth_bounds.assign(GetDepthBoundsWidth() * GetDepthBoundsHeight(), DepthBounds{.min = stored_value, .max = stored_value});
+		depth_bounds_dirty.assign(depth_bounds.size(), 0);
+	}
+
+	void Framebuffer::ResolveImage(std::size_t index, Image &destination) const
+	{
+		PROFILER_ZONE("ResolveImage");
+		const Image *image = GetColorImage(index);
+		if(!image ||
+		   IsDepthFormat(image->GetFormat()) ||
+		   image->GetFormat() != destination.GetFormat() ||
+		   image->GetWidth() != destination.GetWidth() ||
+		   image->GetHeight() != destination.GetHeight() ||
+		   destination.GetSampleCount() != 1)
+			return;
+
+		std::size_t texel_count = image->GetWidth() * image->GetHeight();
+		const std::byte *src = image->GetMappedPtr();
+		std::byte *dst = destination.GetMappedPtr();
+		if(image->GetSampleCount() == 1)
+		{
+			std::memcpy(dst, src, texel_count * GetFormatTexelSize(image->GetFormat()));
+			return;
+		}
+
+		//every packed format has four 8 bit channels, so channels are averaged regardless of their order
+		std::size_t i = 0;
+#if defined(__SSE2__)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i rounding = _mm_set1_epi16(MAX_SAMPLE_COUNT / 2);
+		for(; i + 2 <= texel_count; i += 2)
+		{
+			//samples of two texels: 8 samples x 4 channels
+			__m128i samples0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 16));
+			__m128i samples1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 16 + 16));
+			__m128i sum0 = _mm_add_epi16(_mm_unpacklo_epi8(samples0, zero), _mm_unpackhi_epi8(samples0, zero));
+			__m128i sum1 = _mm_add_epi16(_mm_unpacklo_epi8(samples1, zero), _mm_unpackhi_epi8(samples1, zero));
+			//low 64 bits of each sum hold sample 0 + 2, high 64 bits hold sample 1 + 3
+			__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(sum0, sum1), _mm_unpackhi_epi64(sum0, sum1));
+			sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+			_mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i * 4), _mm_packus_epi16(sum, sum));
+		}
+#endif
+		for(; i < texel_count; i++)
+			for(std::size_t c = 0; c < 4; c++)
+			{
+				unsigned sum = MAX_SAMPLE_COUNT / 2;
+				for(std::size_t s = 0; s < MAX_SAMPLE_COUNT; s++)
+					sum += static_cast<unsigned>(src[(i * MAX_SAMPLE_COUNT + s) * 4 + c]);
+
+				dst[i * 4 + c] = static_cast<std::byte>(sum / MAX_SAMPLE_COUNT);
+			}
+	}
+
+	std::size_t Framebuffer::GetSampleCount() const noexcept
+	{
+		if(depth_image)
+			return depth_image->GetSampleCount();
+
+		for(const auto *image : color_images)
+			if(image)
+				return image->GetSampleCount();
+
+		return 1;
 	}
 
 	Image * Framebuffer::GetColorImage(std::size_t index) noexcept
@@ -89,4 +180,138 @@ namespace Renderer
 	{
 		return depth_image;
 	}
+
+	DepthBounds * Framebuffer::GetDepthBounds() noexcept
+	{
+		if(!is_depth_bounds_valid())
+			return nullptr;
+
+		return depth_bounds.data();
+	}
+
+	const DepthBounds * Framebuffer::GetDepthBounds() const noexcept
+	{
+		if(!is_depth_bounds_valid())
+			return nullptr;
+
+		return depth_bounds.data();
+	}
+
+	std::size_t Framebuffer::GetDepthBoundsWidth() const noexcept
+	{
+		return (depth_bounds_image_width + DEPTH_BOUNDS_BLOCK_SIZE - 1) / DEPTH_BOUNDS_BLOCK_SIZE;
+	}
+
+	std::size_t Framebuffer::GetDepthBoundsHeight() const noexcept
+	{
+		return (depth_bounds_image_height + DEPTH_BOUNDS_BLOCK_SIZE - 1) / DEPTH_BOUNDS_BLOCK_SIZE;
+	}
+
+	void Framebuffer::UpdateDepthBounds(std::size_t block_x, std::size_t block_y) noexcept
+	{
+		if(!is_depth_bounds_valid() || block_x >= GetDepthBoundsWidth() || block_y >= GetDepthBoundsHeight())
+			return;
+
+		std::size_t width = depth_image->GetWidth();
+		std::size_t sample_count = depth_image->GetSampleCount();
+		std::size_t first_x = block_x * DEPTH_BOUNDS_BLOCK_SIZE;
+		std::size_t first_y = block_y * DEPTH_BOUNDS_BLOCK_SIZE;
+		std::size_t last_x = std::min(first_x + DEPTH_BOUNDS_BLOCK_SIZE, width);
+		std::size_t last_y = std::min(first_y + DEPTH_BOUNDS_BLOCK_SIZE, depth_image->GetHeight());
+		const std::byte *data = depth_image->GetMappedPtr();
+		bool has_nan = false;
+
+		float min_depth = INFINITY;
+		float max_depth = -INFINITY;
+		//format is a template parameter, so decoding is not switched per texel
+		auto scan = [&]<Format FORMAT>() noexcept
+		{
+			constexpr std::size_t texel_size = GetFormatTexelSize(FORMAT);
+			for(std::size_t j = first_y; j < last_y; j++)
+				for(std::size_t i = (j * width + first_x) * sample_count; i < (j * width + last_x) * sample_count; i++)
+				{
+					float depth = GetFormatImageDepth(FORMAT, data + i * texel_size);
+					min_depth = std::min(min_depth, depth);
+					max_depth = std::max(max_depth, depth);
+					has_nan |= std::isnan(depth);
+				}
+		};
+
+		switch(depth_image->GetFormat())
+		{
+			case Format::DEPTH16_UNORM:
+				scan.template operator()<Format::DEPTH16_UNORM>();
+				break;
+			case Format::DEPTH24_UNORM:
+				scan.template operator()<Format::DEPTH24_UNORM>();
+				break;
+			default:
+				scan.template operator()<Format::DEPTH32_SFLOAT>();
+				break;
+		}
+
+		//NaN bounds disable both rejection and trivial acceptance of the block
+		if(has_nan)
+			min_depth = max_depth = NAN;
+
+		depth_bounds[block_y * GetDepthBoundsWidth() + block_x] = DepthBounds{.min = min_depth, .max = max_depth};
+		depth_bounds_dirty[block_y * GetDepthBoundsWidth() + block_x] = 0;
+	}
+
+	void Framebuffer::ExpandDepthBounds(std::size_t x, std::size_t y, float depth) noexcept
+	{
+		if(!is_depth_bounds_valid() || x >= depth_bounds_image_width || y >= depth_bounds_image_height)
+			return;
+
+		DepthBounds &bounds = depth_bounds[(y / DEPTH_BOUNDS_BLOCK_SIZE) * GetDepthBoundsWidth() + x / DEPTH_BOUNDS_BLOCK_SIZE];
+		depth = QuantizeFormatDepth(depth_image->GetFormat(), depth);
+		if(std::isnan(depth) || std::isnan(bounds.min))
+		{
+			bounds.min = bounds.max = NAN;
+			return;
+		}
+
+		bounds.min = std::min(bounds.min, depth);
+		bounds.max = std::max(bounds.max, depth);
+	}
+
+	void Framebuffer::ExpandBlockDepthBounds(std::size_t block_x, std::size_t block_y, float min_depth, float max_depth) noexcept
+	{
+		if(!is_depth_bounds_valid() || block_x >= GetDepthBoundsWidth() || block_y >= GetDepthBoundsHeight())
+			return;
+
+		std::size_t index = block_y * GetDepthBoundsWidth() + block_x;
+		DepthBounds &bounds = depth_bounds[index];
+		depth_bounds_dirty[index] = 1;
+		if(std::isnan(min_depth) || std::isnan(max_depth) || std::isnan(bounds.min))
+		{
+			bounds.min = bounds.max = NAN;
+			return;
+		}
+
+		//quantization is monotonic, so the quantized range holds every quantized written depth
+		bounds.min = std::min(bounds.min, QuantizeFormatDepth(depth_image->GetFormat(), min_depth));
+		bounds.max = std::max(bounds.max, QuantizeFormatDepth(depth_image->GetFormat(), max_depth));
+	}
+
+	void Framebuffer::UpdateDirtyDepthBounds(std::size_t min_x, std::size_t min_y, std::size_t max_x, std::size_t max_y) noexcept
+	{
+		if(!is_depth_bounds_valid())
+			return;
+
+		std::size_t last_block_x = std::min(max_x / DEPTH_BOUNDS_BLOCK_SIZE, GetDepthBoundsWidth() - 1);
+		std::size_t last_block_y = std::min(max_y / DEPTH_BOUNDS_BLOCK_SIZE, GetDepthBoundsHeight() - 1);
+		for(std::size_t block_y = min_y / DEPTH_BOUNDS_BLOCK_SIZE; block_y <= last_block_y; block_y++)
+			for(std::size_t block_x = min_x / DEPTH_BOUNDS_BLOCK_SIZE; block_x <= last_block_x; block_x++)
+				if(depth_bounds_dirty[block_y * GetDepthBoundsWidth() + block_x])
+					UpdateDepthBounds(block_x, block_y);
+	}
+
+	bool Framebuffer::is_depth_bounds_valid() const noexcept
+	{
+		return depth_image &&
+			   !depth_bounds.empty() &&
+			   depth_image->GetWidth() == depth_bounds_image_width &&
+			   depth_image->GetHeight() == depth_bounds_image_height;
+	}
 };
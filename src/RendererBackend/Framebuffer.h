@@ -11,9 +11,20 @@ namespace Renderer
 		float depth;
 	};
 
+	//conservative depth range of a DEPTH_BOUNDS_BLOCK_SIZE x DEPTH_BOUNDS_BLOCK_SIZE block of the depth image.
+	//Depth is kept as it is read back from the depth format(see QuantizeFormatDepth)
+	struct DepthBounds
+	{
+		float min;
+		float max;
+	};
+
+	//all images of a framebuffer must have the same sample count
 	class Framebuffer
 	{
 	public:
+		constexpr static std::size_t DEPTH_BOUNDS_BLOCK_SIZE = 8;
+
 		Framebuffer(std::span<Image *> _color_images = {}, Image *_depth_image = {});
 		~Framebuffer() = default;
 		Framebuffer(const Framebuffer &) = default;
@@ -27,14 +38,47 @@ namespace Renderer
 		void ClearImage(const ClearValue &value, std::size_t index);
 		void ClearDepthImage(float value);
 
+		//averages samples of the multisampled color image into the single sampled destination
+		//of the same extent and format(packed color formats only)
+		void ResolveImage(std::size_t index, Image &destination) const;
+
+		std::size_t GetSampleCount() const noexcept;
+
 		Image * GetColorImage(std::size_t index) noexcept;
 		const Image * GetColorImage(std::size_t index) const noexcept;
 
 		Image * GetDepthImage() noexcept;
 		const Image * GetDepthImage() const noexcept;
 
+		//coarse min/max depth of the depth image blocks (hierarchical z).
+		//Bounds are (re)created by ClearDepthImage and are not available(nullptr)
+		//if the depth image has been resized since the last clear
+		DepthBounds * GetDepthBounds() noexcept;
+		const DepthBounds * GetDepthBounds() const noexcept;
+		std::size_t GetDepthBoundsWidth() const noexcept;
+		std::size_t GetDepthBoundsHeight() const noexcept;
+
+		//recomputes bounds of the block from all samples of the depth image
+		void UpdateDepthBounds(std::size_t block_x, std::size_t block_y) noexcept;
+		//widens bounds of the block which contains pixel (x, y) by written depth(quantized by the depth format)
+		void ExpandDepthBounds(std::size_t x, std::size_t y, float depth) noexcept;
+		//widens bounds of the block by the range of written depths(NaN if any of them is NaN).
+		//Widened bounds stay conservative, but overwritten texels may have held the far bound,
+		//so the block is marked to be recomputed by UpdateDirtyDepthBounds
+		void ExpandBlockDepthBounds(std::size_t block_x, std::size_t block_y, float min_depth, float max_depth) noexcept;
+		//recomputes bounds of the marked blocks which intersect the pixel rect(inclusive)
+		void UpdateDirtyDepthBounds(std::size_t min_x, std::size_t min_y, std::size_t max_x, std::size_t max_y) noexcept;
+
 	private:
+		bool is_depth_bounds_valid() const noexcept;
+
 		std::vector<Image *> color_images;
 		Image * depth_image;
+
+		std::vector<DepthBounds> depth_bounds;
+		//blocks are owned by one thread at a time, so flags are bytes written without atomics
+		std::vector<std::uint8_t> depth_bounds_dirty;
+		std::size_t depth_bounds_image_width;
+		std::size_t depth_bounds_image_height;
 	};
 };
@@ -1,12 +1,15 @@
 #include "Image.h"
+#include <cassert>
+#include <cmath>
 
 namespace Renderer
 {
-	Image::Image(std::size_t _width, std::size_t _height, Format _format)
-		: width(_width), height(_height), format(_format)
+	Image::Image(std::size_t _width, std::size_t _height, Format _format, std::size_t _sample_count)
+		: width(_width), height(_height), format(_format), sample_count(_sample_count)
 	{
+		assert(sample_count == 1 || sample_count == MAX_SAMPLE_COUNT);
 		if(width * height != 0)
-			data.resize(width * height * GetFormatTexelSize(format));
+			data.resize(width * height * sample_count * GetFormatTexelSize(format));
 	}
 
 	void Image::Destroy() noexcept
@@ -22,15 +25,17 @@ namespace Renderer
 		return !data.empty();
 	}
 
-	void Image::Resize(std::size_t _width, std::size_t _height, Format _format)
+	void Image::Resize(std::size_t _width, std::size_t _height, Format _format, std::size_t _sample_count)
 	{
+		assert(_sample_count == 1 || _sample_count == MAX_SAMPLE_COUNT);
 		width = _width;
 		height = _height;
 		format = _format;
+		sample_count = _sample_count;
 
 		data.clear();
 		if(width * height != 0)
-			data.resize(width * height * GetFormatTexelSize(format));
+			data.resize(width * height * sample_count * GetFormatTexelSize(format));
 	}
 
 	std::size_t Image::GetWidth() const noexcept
@@ -48,6 +53,11 @@ namespace Renderer
 		return format;
 	}
 
+	std::size_t Image::GetSampleCount() const noexcept
+	{
+		return sample_count;
+	}
+
 	std::byte * Image::GetMappedPtr() noexcept
 	{
 		return data.data();
@@ -58,42 +68,55 @@ namespace Renderer
 		return data.data();
 	}
 
-	hrs::math::glsl::vec4 Image::GetValueColor(std::size_t i, std::size_t j) const noexcept
+	hrs::math::glsl::vec4 Image::GetValueColor(std::size_t i, std::size_t j, std::size_t sample) const noexcept
 	{
-		if(i >= width || j >= height)
+		if(i >= width || j >= height || sample >= sample_count)
 			return {0, 0, 0, 0};
 
-		const std::byte *target = &data[j * width * GetFormatTexelSize(format) + i * GetFormatTexelSize(format)];
-
-
 		//switch format -> now we are working only with 32 packed formats!!!
-		return GetFormatImageColor(format, target);
+		return GetFormatImageColor(format, &data[get_texel_offset(i, j, sample)]);
 	}
 
-	float Image::GetValueDepth(std::size_t i, std::size_t j) const noexcept
+	float Image::GetValueDepth(std::size_t i, std::size_t j, std::size_t sample) const noexcept
 	{
-		if(i >= width || j >= height)
+		if(i >= width || j >= height || sample >= sample_count)
 			return NAN;
 
-		const std::byte *target = &data[j * width * GetFormatTexelSize(format) + i * GetFormatTexelSize(format)];
-		return GetFormatImageDepth(format, target);
+		return GetFormatImageDepth(format, &data[get_texel_offset(i, j, sample)]);
 	}
 
-	void Image::SetValueColor(std::size_t i, std::size_t j, const hrs::math::glsl::vec4 &color) noexcept
+	void Image::SetValueColor(std::size_t i, std::size_t j, const hrs::math::glsl::vec4 &color, std::size_t sample) noexcept
 	{
-		if(i >= width || j >= height)
+		if(i >= width || j >= height || sample >= sample_count)
 			return;
 
-		std::byte *target = &data[j * width * GetFormatTexelSize(format) + i * GetFormatTexelSize(format)];
-		SetFormatImageColor(format, target, color);
+		SetValueColorUnchecked(i, j, color, sample);
 	}
 
-	void Image::SetValueDepth(std::size_t i, std::size_t j, float depth) noexcept
+	void Image::SetValueDepth(std::size_t i, std::size_t j, float depth, std::size_t sample) noexcept
 	{
-		if(i >= width || j >= height)
+		if(i >= width || j >= height || sample >= sample_count)
 			return;
 
-		std::byte *target = &data[j * width * GetFormatTexelSize(format) + i * GetFormatTexelSize(format)];
-		SetFormatImageDepth(format, target, depth);
+		SetValueDepthUnchecked(i, j, depth, sample);
+	}
+
+	void Image::SetValueColorUnchecked(std::size_t i, std::size_t j, const hrs::math::glsl::vec4 &color, std::size_t sample) noexcept
+	{
+		assert(i < width && j < height && sample < sample_count);
+
+		SetFormatImageColor(format, &data[get_texel_offset(i, j, sample)], color);
+	}
+
+	void Image::SetValueDepthUnchecked(std::size_t i, std::size_t j, float depth, std::size_t sample) noexcept
+	{
+		assert(i < width && j < height && sample < sample_count);
+
+		SetFormatImageDepth(format, &data[get_texel_offset(i, j, sample)], depth);
+	}
+
+	std::size_t Image::get_texel_offset(std::size_t i, std::size_t j, std::size_t sample) const noexcept
+	{
+		return ((j * width + i) * sample_count + sample) * GetFormatTexelSize(format);
 	}
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <vector>
 #include "../hrs/math/vector.hpp"
 
@@ -12,9 +13,47 @@ namespace Renderer
 		BGRA32_PACKED,
 		ARGB32_PACKED,
 		ABGR32_PACKED,
-		DEPTH32_SFLOAT
+		DEPTH32_SFLOAT,
+		DEPTH16_UNORM,
+		DEPTH24_UNORM//low 24 bits of a 32 bit texel, high bits are zero
 	};
 
+	constexpr bool IsDepthFormat(Format format) noexcept
+	{
+		return format == Format::DEPTH32_SFLOAT ||
+			   format == Format::DEPTH16_UNORM ||
+			   format == Format::DEPTH24_UNORM;
+	}
+
+	//largest code of the unorm depth format, 0 for float formats
+	constexpr float GetFormatDepthUnormScale(Format format) noexcept
+	{
+		switch(format)
+		{
+			case Format::DEPTH16_UNORM:
+				return 65535.0f;
+				break;
+			case Format::DEPTH24_UNORM:
+				return 16777215.0f;
+				break;
+			default:
+				return 0.0f;
+				break;
+		}
+	}
+
+	//depth is clamped to [0, 1](NaN to 0) and rounded to the nearest code.
+	//Rounded code is clamped again: 24 bit codes + 0.5 may round up beyond the scale in float.
+	//Rasterizer kernels encode depth with the same float operations
+	constexpr std::uint32_t EncodeUnormDepth(float depth, float scale) noexcept
+	{
+		float clamped = (depth > 0.0f ? std::min(depth, 1.0f) : 0.0f);
+		return static_cast<std::uint32_t>(std::min(clamped * scale + 0.5f, scale));
+	}
+
+	//multisampled images have MAX_SAMPLE_COUNT samples per texel
+	constexpr std::size_t MAX_SAMPLE_COUNT = 4;
+
 	constexpr std::size_t GetFormatTexelSize(Format format) noexcept
 	{
 		switch(format)
@@ -24,11 +63,18 @@ namespace Renderer
 			case Format::ARGB32_PACKED:
 			case Format::ABGR32_PACKED:
 			case Format::DEPTH32_SFLOAT:
+			case Format::DEPTH24_UNORM:
 				return 4;
 				break;
+			case Format::DEPTH16_UNORM:
+				return 2;
+				break;
 		}
 	}
 
+	constexpr void SetFormatImageDepth(Format format, std::byte *data, float depth) noexcept;
+	constexpr float GetFormatImageDepth(Format format, const std::byte *data) noexcept;
+
 	constexpr void SetFormatImageColor(Format format, std::byte *data, const hrs::math::glsl::vec4 &color) noexcept
 	{
 		constexpr auto float_to_byte = [](float value) noexcept
@@ -83,10 +129,9 @@ namespace Renderer
 				}
 				break;
 			case Format::DEPTH32_SFLOAT:
-				{
-					float depth = color[0];
-					*reinterpret_cast<float *>(data) = depth;
-				}
+			case Format::DEPTH16_UNORM:
+			case Format::DEPTH24_UNORM:
+				SetFormatImageDepth(format, data, color[0]);
 				break;
 		}
 	}
@@ -138,16 +183,16 @@ namespace Renderer
 				}
 				break;
 			case Format::DEPTH32_SFLOAT:
-				{
-					float depth = *reinterpret_cast<const float *>(data);
-					out_color = {depth};
-				}
+			case Format::DEPTH16_UNORM:
+			case Format::DEPTH24_UNORM:
+				out_color = {GetFormatImageDepth(format, data)};
 				break;
 		}
 
 		return out_color;
 	}
 
+	//color formats keep depth as float
 	constexpr void SetFormatImageDepth(Format format, std::byte *data, float depth) noexcept
 	{
 		switch(format)
@@ -159,6 +204,13 @@ namespace Renderer
 			case Format::DEPTH32_SFLOAT:
 				*reinterpret_cast<float *>(data) = depth;
 				break;
+			case Format::DEPTH16_UNORM:
+				*reinterpret_cast<std::uint16_t *>(data) =
+					static_cast<std::uint16_t>(EncodeUnormDepth(depth, GetFormatDepthUnormScale(format)));
+				break;
+			case Format::DEPTH24_UNORM:
+				*reinterpret_cast<std::uint32_t *>(data) = EncodeUnormDepth(depth, GetFormatDepthUnormScale(format));
+				break;
 		}
 	}
 
@@ -173,13 +225,32 @@ namespace Renderer
 			case Format::DEPTH32_SFLOAT:
 				return *reinterpret_cast<const float *>(data);
 				break;
+			case Format::DEPTH16_UNORM:
+				return static_cast<float>(*reinterpret_cast<const std::uint16_t *>(data)) * (1.0f / GetFormatDepthUnormScale(format));
+				break;
+			case Format::DEPTH24_UNORM:
+				return static_cast<float>(*reinterpret_cast<const std::uint32_t *>(data) & 0xFFFFFF) *
+					   (1.0f / GetFormatDepthUnormScale(format));
+				break;
 		}
 	}
 
+	//depth as it is read back after being written to the format
+	constexpr float QuantizeFormatDepth(Format format, float depth) noexcept
+	{
+		float scale = GetFormatDepthUnormScale(format);
+		if(scale == 0.0f)
+			return depth;
+
+		return static_cast<float>(EncodeUnormDepth(depth, scale)) * (1.0f / scale);
+	}
+
+	//samples of a texel are stored next to each other: sample s of texel (i, j)
+	//is at index (j * width + i) * sample_count + s
 	class Image
 	{
 	public:
-		Image(std::size_t _width = {}, std::size_t _height = {}, Format _format = {});
+		Image(std::size_t _width = {}, std::size_t _height = {}, Format _format = {}, std::size_t _sample_count = 1);
 		~Image() = default;
 		Image(const Image &) = default;
 		Image(Image &&) = default;
@@ -188,24 +259,32 @@ namespace Renderer
 
 		void Destroy() noexcept;
 		bool IsCreated() const noexcept;
-		void Resize(std::size_t _width = {}, std::size_t _height = {}, Format _format = {});
+		void Resize(std::size_t _width = {}, std::size_t _height = {}, Format _format = {}, std::size_t _sample_count = 1);
 
 		std::size_t GetWidth() const noexcept;
 		std::size_t GetHeight() const noexcept;
 		Format GetFormat() const noexcept;
+		std::size_t GetSampleCount() const noexcept;
 
 		std::byte * GetMappedPtr() noexcept;
 		const std::byte * GetMappedPtr() const noexcept;
 
-		hrs::math::glsl::vec4 GetValueColor(std::size_t i, std::size_t j) const noexcept;
-		float GetValueDepth(std::size_t i, std::size_t j) const noexcept;
-		void SetValueColor(std::size_t i, std::size_t j, const hrs::math::glsl::vec4 &color) noexcept;
-		void SetValueDepth(std::size_t i, std::size_t j, float depth) noexcept;
+		hrs::math::glsl::vec4 GetValueColor(std::size_t i, std::size_t j, std::size_t sample = 0) const noexcept;
+		float GetValueDepth(std::size_t i, std::size_t j, std::size_t sample = 0) const noexcept;
+		//texels outside of the image are ignored
+		void SetValueColor(std::size_t i, std::size_t j, const hrs::math::glsl::vec4 &color, std::size_t sample = 0) noexcept;
+		void SetValueDepth(std::size_t i, std::size_t j, float depth, std::size_t sample = 0) noexcept;
+		//texel must be inside of the image, it is checked only by assert(for loops clipped to the draw or scissor rect)
+		void SetValueColorUnchecked(std::size_t i, std::size_t j, const hrs::math::glsl::vec4 &color, std::size_t sample = 0) noexcept;
+		void SetValueDepthUnchecked(std::size_t i, std::size_t j, float depth, std::size_t sample = 0) noexcept;
 
 	private:
+		std::size_t get_texel_offset(std::size_t i, std::size_t j, std::size_t sample) const noexcept;
+
 		std::size_t width;
 		std::size_t height;
 		Format format;
+		std::size_t sample_count;
 
 		std::vector<std::byte> data;
 	};
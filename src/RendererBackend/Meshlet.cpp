@@ -0,0 +1,221 @@
+#include "Meshlet.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace Renderer
+{
+	namespace
+	{
+		hrs::math::glsl::vec3 get_position(const std::byte *vertex_data,
+										   std::size_t vertex_stride,
+										   std::size_t position_offset,
+										   std::uint32_t index) noexcept
+		{
+			float position[3];
+			std::memcpy(position, vertex_data + index * vertex_stride + position_offset, sizeof(position));
+			return hrs::math::glsl::vec3(position[0], position[1], position[2]);
+		}
+
+		void compute_meshlet_bounds(const std::byte *vertex_data,
+									std::size_t vertex_stride,
+									std::size_t position_offset,
+									const std::uint32_t *index_data,
+									Meshlet &meshlet)
+		{
+			const std::uint32_t *indices = index_data + meshlet.index_offset;
+			std::size_t index_count = meshlet.triangle_count * 3;
+
+			//sphere is centered at the box center, its radius reaches the farthest vertex
+			hrs::math::glsl::vec3 min = get_position(vertex_data, vertex_stride, position_offset, indices[0]);
+			hrs::math::glsl::vec3 max = min;
+			for(std::size_t i = 1; i < index_count; i++)
+			{
+				hrs::math::glsl::vec3 position = get_position(vertex_data, vertex_stride, position_offset, indices[i]);
+				for(std::size_t j = 0; j < 3; j++)
+				{
+					min[j] = std::min(min[j], position[j]);
+					max[j] = std::max(max[j], position[j]);
+				}
+			}
+
+			meshlet.sphere_center = (min + max) * 0.5f;
+			float max_square_distance = 0.0f;
+			for(std::size_t i = 0; i < index_count; i++)
+			{
+				auto offset = get_position(vertex_data, vertex_stride, position_offset, indices[i]) - meshlet.sphere_center;
+				max_square_distance = std::max(max_square_distance, offset * offset);
+			}
+
+			meshlet.sphere_radius = std::sqrt(max_square_distance);
+
+			//cone axis is the average of unit normals, degenerate triangles are skipped
+			std::array<hrs::math::glsl::vec3, MAX_MESHLET_TRIANGLE_COUNT> normals;
+			std::size_t normal_count = 0;
+			hrs::math::glsl::vec3 axis(0.0f, 0.0f, 0.0f);
+			for(std::size_t i = 0; i < index_count; i += 3)
+			{
+				hrs::math::glsl::vec3 v0 = get_position(vertex_data, vertex_stride, position_offset, indices[i]);
+				hrs::math::glsl::vec3 v1 = get_position(vertex_data, vertex_stride, position_offset, indices[i + 1]);
+				hrs::math::glsl::vec3 v2 = get_position(vertex_data, vertex_stride, position_offset, indices[i + 2]);
+				hrs::math::glsl::vec3 normal = (v1 - v0) ^ (v2 - v0);
+				float normal_length = std::sqrt(normal * normal);
+				if(normal_length == 0.0f)
+					continue;
+
+				normals[normal_count] = normal * (1.0f / normal_length);
+				axis += normals[normal_count];
+				normal_count++;
+			}
+
+			//opposite normals cancel out, the meshlet keeps the default cone which is never back facing
+			float axis_length = std::sqrt(axis * axis);
+			if(axis_length == 0.0f)
+				return;
+
+			axis *= 1.0f / axis_length;
+			float min_dot = 1.0f;
+			for(std::size_t i = 0; i < normal_count; i++)
+				min_dot = std::min(min_dot, normals[i] * axis);
+
+			meshlet.cone_axis = axis;
+			if(min_dot > 0.0f)
+				meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+		}
+	};
+
+	void BuildMeshlets(const std::byte *vertex_data,
+					   std::size_t vertex_stride,
+					   std::size_t position_offset,
+					   const std::uint32_t *index_data,
+					   std::size_t count,
+					   std::uint32_t *meshlet_index_data,
+					   std::vector<Meshlet> &meshlets)
+	{
+		std::size_t triangle_count = count / 3;
+		if(triangle_count == 0)
+			return;
+
+		//triangles of every vertex(compressed rows indexed by the vertex index)
+		std::uint32_t max_index = *std::max_element(index_data, index_data + triangle_count * 3);
+		std::vector<std::uint32_t> vertex_triangle_offsets(static_cast<std::size_t>(max_index) + 2, 0);
+		for(std::size_t i = 0; i < triangle_count * 3; i++)
+			vertex_triangle_offsets[index_data[i] + 1]++;
+
+		for(std::size_t i = 1; i < vertex_triangle_offsets.size(); i++)
+			vertex_triangle_offsets[i] += vertex_triangle_offsets[i - 1];
+
+		std::vector<std::uint32_t> vertex_triangles(triangle_count * 3);
+		std::vector<std::uint32_t> fill_offsets(vertex_triangle_offsets.begin(), vertex_triangle_offsets.end() - 1);
+		for(std::size_t i = 0; i < triangle_count * 3; i++)
+			vertex_triangles[fill_offsets[index_data[i]]++] = static_cast<std::uint32_t>(i / 3);
+
+		std::vector<hrs::math::glsl::vec3> triangle_normals(triangle_count);
+		for(std::size_t i = 0; i < triangle_count; i++)
+		{
+			hrs::math::glsl::vec3 v0 = get_position(vertex_data, vertex_stride, position_offset, index_data[i * 3]);
+			hrs::math::glsl::vec3 v1 = get_position(vertex_data, vertex_stride, position_offset, index_data[i * 3 + 1]);
+			hrs::math::glsl::vec3 v2 = get_position(vertex_data, vertex_stride, position_offset, index_data[i * 3 + 2]);
+			hrs::math::glsl::vec3 normal = (v1 - v0) ^ (v2 - v0);
+			float normal_length = std::sqrt(normal * normal);
+			triangle_normals[i] = (normal_length > 0.0f ? normal * (1.0f / normal_length) : normal);
+		}
+
+		std::vector<std::uint8_t> is_emitted(triangle_count, 0);
+		std::array<std::uint32_t, MAX_MESHLET_VERTEX_COUNT> vertices;
+		std::size_t written_index_count = 0;
+		std::size_t next_seed = 0;
+
+		auto get_new_vertex_count = [&](std::size_t triangle, std::size_t vertex_count) noexcept
+		{
+			std::size_t new_vertex_count = 0;
+			for(std::size_t j = 0; j < 3; j++)
+				new_vertex_count += (std::find(vertices.begin(),
+											   vertices.begin() + vertex_count,
+											   index_data[triangle * 3 + j]) == vertices.begin() + vertex_count);
+
+			return new_vertex_count;
+		};
+
+		//meshlets grow over triangles sharing their vertices: the triangle adding the fewest new vertices
+		//is taken first and ties are broken by the normal closest to the meshlet normal,
+		//so meshlets stay compact and their cones narrow
+		while(true)
+		{
+			while(next_seed < triangle_count && is_emitted[next_seed])
+				next_seed++;
+
+			if(next_seed == triangle_count)
+				break;
+
+			Meshlet meshlet{.index_offset = static_cast<std::uint32_t>(written_index_count)};
+			hrs::math::glsl::vec3 normal_sum(0.0f, 0.0f, 0.0f);
+			std::size_t triangle = next_seed;
+			while(true)
+			{
+				for(std::size_t j = 0; j < 3; j++)
+				{
+					std::uint32_t index = index_data[triangle * 3 + j];
+					if(std::find(vertices.begin(), vertices.begin() + meshlet.vertex_count, index) == vertices.begin() + meshlet.vertex_count)
+						vertices[meshlet.vertex_count++] = index;
+
+					meshlet_index_data[written_index_count++] = index;
+				}
+
+				is_emitted[triangle] = 1;
+				normal_sum += triangle_normals[triangle];
+				meshlet.triangle_count++;
+				if(meshlet.triangle_count == MAX_MESHLET_TRIANGLE_COUNT)
+					break;
+
+				std::size_t best_triangle = triangle_count;
+				std::size_t best_new_vertex_count = 4;
+				float best_dot = 0.0f;
+				for(std::size_t v = 0; v < meshlet.vertex_count; v++)
+					for(std::uint32_t k = vertex_triangle_offsets[vertices[v]]; k < vertex_triangle_offsets[vertices[v] + 1]; k++)
+					{
+						std::uint32_t candidate = vertex_triangles[k];
+						if(is_emitted[candidate])
+							continue;
+
+						std::size_t new_vertex_count = get_new_vertex_count(candidate, meshlet.vertex_count);
+						if(meshlet.vertex_count + new_vertex_count > MAX_MESHLET_VERTEX_COUNT)
+							continue;
+
+						float dot = triangle_normals[candidate] * normal_sum;
+						if(new_vertex_count < best_new_vertex_count ||
+						   (new_vertex_count == best_new_vertex_count && dot > best_dot))
+						{
+							best_triangle = candidate;
+							best_new_vertex_count = new_vertex_count;
+							best_dot = dot;
+						}
+					}
+
+				//nothing adjacent fits, the next meshlet starts from the first triangle left
+				if(best_triangle == triangle_count)
+					break;
+
+				triangle = best_triangle;
+			}
+
+			compute_meshlet_bounds(vertex_data, vertex_stride, position_offset, meshlet_index_data, meshlet);
+			meshlets.push_back(meshlet);
+		}
+	}
+
+	bool IsMeshletOutsideFrustum(const Meshlet &meshlet, const hrs::math::frustum<float> &frustum) noexcept
+	{
+		return frustum.test_sphere(meshlet.sphere_center, meshlet.sphere_radius) == hrs::math::frustum_test_result::outside;
+	}
+
+	bool IsMeshletBackFacing(const Meshlet &meshlet, const hrs::math::glsl::vec3 &camera_position) noexcept
+	{
+		//every point of the sphere sees the cone from behind: the angle between the view direction
+		//and the axis is less than 90 degrees minus the cone half angle
+		hrs::math::glsl::vec3 direction = meshlet.sphere_center - camera_position;
+		float distance = std::sqrt(direction * direction);
+		return direction * meshlet.cone_axis > meshlet.cone_cutoff * distance + meshlet.sphere_radius;
+	}
+};
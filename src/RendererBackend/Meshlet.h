@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../hrs/math/vector.hpp"
+#include "../hrs/math/frustum.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Renderer
+{
+	constexpr std::size_t MAX_MESHLET_VERTEX_COUNT = 64;
+	constexpr std::size_t MAX_MESHLET_TRIANGLE_COUNT = 124;
+
+	//contiguous range of triangles of an index list with the bounds of their vertices.
+	//Bounds are in the space of the vertex positions(e.g. model space)
+	struct Meshlet
+	{
+		std::uint32_t index_offset = 0;//offset of the first index in the index list
+		std::uint32_t triangle_count = 0;
+		std::uint32_t vertex_count = 0;//unique vertices referenced by the triangles
+		hrs::math::glsl::vec3 sphere_center{};
+		float sphere_radius = 0.0f;
+		//normals cross(v1 - v0, v2 - v0) of all triangles are within the cone around the axis
+		hrs::math::glsl::vec3 cone_axis{};
+		//sine of the cone half angle, 1 if the cone is not narrower than a hemisphere(never back facing)
+		float cone_cutoff = 1.0f;
+	};
+
+	//splits the triangle list into meshlets of at most MAX_MESHLET_VERTEX_COUNT vertices and
+	//MAX_MESHLET_TRIANGLE_COUNT triangles. Meshlets are grown over adjacent triangles, so the triangles
+	//are reordered: they are written to meshlet_index_data(count - count % 3 indices, must not alias index_data)
+	//and the appended meshlets refer to it. Winding of every triangle is kept.
+	//Positions are three floats at position_offset of every vertex
+	void BuildMeshlets(const std::byte *vertex_data,
+					   std::size_t vertex_stride,
+					   std::size_t position_offset,
+					   const std::uint32_t *index_data,
+					   std::size_t count,
+					   std::uint32_t *meshlet_index_data,
+					   std::vector<Meshlet> &meshlets);
+
+	bool IsMeshletOutsideFrustum(const Meshlet &meshlet, const hrs::math::frustum<float> &frustum) noexcept;
+	//true if every triangle of the meshlet faces away from the camera(its normal points away from it)
+	bool IsMeshletBackFacing(const Meshlet &meshlet, const hrs::math::glsl::vec3 &camera_position) noexcept;
+};
@@ -0,0 +1,40 @@
+#include "OcclusionQuery.h"
+
+namespace Renderer
+{
+	OcclusionQuery::OcclusionQuery() noexcept
+		: pending_passed_samples(0),
+		  passed_samples(0),
+		  is_available(false) {}
+
+	bool OcclusionQuery::IsAvailable() const noexcept
+	{
+		return is_available.load(std::memory_order_acquire);
+	}
+
+	std::uint64_t OcclusionQuery::GetResult() const noexcept
+	{
+		return passed_samples.load(std::memory_order_acquire);
+	}
+
+	bool OcclusionQuery::IsVisible() const noexcept
+	{
+		return !IsAvailable() || GetResult() != 0;
+	}
+
+	void OcclusionQuery::Begin() noexcept
+	{
+		pending_passed_samples = 0;
+	}
+
+	void OcclusionQuery::AddPassedSamples(std::uint64_t count) noexcept
+	{
+		pending_passed_samples += count;
+	}
+
+	void OcclusionQuery::End() noexcept
+	{
+		passed_samples.store(pending_passed_samples, std::memory_order_release);
+		is_available.store(true, std::memory_order_release);
+	}
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace Renderer
+{
+	//counts samples which passed the depth test(and were not discarded) in the draws of a pipeline
+	//between its BeginOcclusionQuery and EndOcclusionQuery.
+	//Result of the last ended query stays readable from any thread while the next one is counted,
+	//so it may be read synchronously after the draws or from a later frame of a command queue
+	class OcclusionQuery
+	{
+	public:
+		OcclusionQuery() noexcept;
+		~OcclusionQuery() = default;
+		OcclusionQuery(const OcclusionQuery &) = delete;
+		OcclusionQuery(OcclusionQuery &&) = delete;
+		OcclusionQuery & operator=(const OcclusionQuery &) = delete;
+		OcclusionQuery & operator=(OcclusionQuery &&) = delete;
+
+		//true once any query has been ended
+		bool IsAvailable() const noexcept;
+		//passed samples of the last ended query, 0 if no query has been ended
+		std::uint64_t GetResult() const noexcept;
+		//unavailable queries are treated as visible, so the first frame draws everything
+		bool IsVisible() const noexcept;
+
+		//called by the pipeline on the thread which executes the draws
+		void Begin() noexcept;
+		void AddPassedSamples(std::uint64_t count) noexcept;
+		void End() noexcept;
+
+	private:
+		std::uint64_t pending_passed_samples;
+		std::atomic<std::uint64_t> passed_samples;
+		std::atomic<bool> is_available;
+	};
+};
@@ -0,0 +1,280 @@
+#include "OutputMerger.h"
+#include <array>
+#include <bit>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Renderer
+{
+	namespace
+	{
+		constexpr int ALPHA_CHANNEL = 3;
+
+		bool get_channel_shifts(Format format, std::uint32_t (&shifts)[4]) noexcept
+		{
+			auto set = [&](std::uint32_t r, std::uint32_t g, std::uint32_t b, std::uint32_t a) noexcept
+			{
+				shifts[0] = r;
+				shifts[1] = g;
+				shifts[2] = b;
+				shifts[3] = a;
+				return true;
+			};
+
+			switch(format)
+			{
+				case Format::RGBA32_PACKED:
+					return set(24, 16, 8, 0);
+					break;
+				case Format::BGRA32_PACKED:
+					return set(8, 16, 24, 0);
+					break;
+				case Format::ARGB32_PACKED:
+					return set(16, 8, 0, 24);
+					break;
+				case Format::ABGR32_PACKED:
+					return set(0, 8, 16, 24);
+					break;
+				default:
+					return false;
+					break;
+			}
+		}
+
+		constexpr std::size_t BLEND_FACTOR_COUNT = static_cast<std::size_t>(BlendFactor::OneMinusDstAlpha) + 1;
+
+#if defined(__SSE2__)
+		template<BlendFactor FACTOR>
+		__m128 blend_factor(__m128 src, __m128 dst) noexcept
+		{
+			const __m128 one = _mm_set1_ps(1.0f);
+			if constexpr(FACTOR == BlendFactor::Zero)
+				return _mm_setzero_ps();
+			else if constexpr(FACTOR == BlendFactor::One)
+				return one;
+			else if constexpr(FACTOR == BlendFactor::SrcColor)
+				return src;
+			else if constexpr(FACTOR == BlendFactor::OneMinusSrcColor)
+				return _mm_sub_ps(one, src);
+			else if constexpr(FACTOR == BlendFactor::DstColor)
+				return dst;
+			else if constexpr(FACTOR == BlendFactor::OneMinusDstColor)
+				return _mm_sub_ps(one, dst);
+			else if constexpr(FACTOR == BlendFactor::SrcAlpha)
+				return _mm_shuffle_ps(src, src, _MM_SHUFFLE(3, 3, 3, 3));
+			else if constexpr(FACTOR == BlendFactor::OneMinusSrcAlpha)
+				return _mm_sub_ps(one, _mm_shuffle_ps(src, src, _MM_SHUFFLE(3, 3, 3, 3)));
+			else if constexpr(FACTOR == BlendFactor::DstAlpha)
+				return _mm_shuffle_ps(dst, dst, _MM_SHUFFLE(3, 3, 3, 3));
+			else
+				return _mm_sub_ps(one, _mm_shuffle_ps(dst, dst, _MM_SHUFFLE(3, 3, 3, 3)));
+		}
+
+		//multiplications by one and zero factors are folded away at compile time
+		template<BlendFactor FACTOR>
+		__m128 blend_term(__m128 value, __m128 src, __m128 dst) noexcept
+		{
+			if constexpr(FACTOR == BlendFactor::Zero)
+				return _mm_setzero_ps();
+			else if constexpr(FACTOR == BlendFactor::One)
+				return value;
+			else
+				return _mm_mul_ps(value, blend_factor<FACTOR>(src, dst));
+		}
+
+		template<BlendOp OP, BlendFactor SRC_FACTOR, BlendFactor DST_FACTOR>
+		void blend_equation(const float *src, const float *dst, float *result) noexcept
+		{
+			__m128 s = _mm_loadu_ps(src);
+			__m128 d = _mm_loadu_ps(dst);
+			__m128 r;
+			if constexpr(OP == BlendOp::Add)
+				r = _mm_add_ps(blend_term<SRC_FACTOR>(s, s, d), blend_term<DST_FACTOR>(d, s, d));
+			else if constexpr(OP == BlendOp::Subtract)
+				r = _mm_sub_ps(blend_term<SRC_FACTOR>(s, s, d), blend_term<DST_FACTOR>(d, s, d));
+			else if constexpr(OP == BlendOp::ReverseSubtract)
+				r = _mm_sub_ps(blend_term<DST_FACTOR>(d, s, d), blend_term<SRC_FACTOR>(s, s, d));
+			else if constexpr(OP == BlendOp::Min)
+				r = _mm_min_ps(s, d);
+			else
+				r = _mm_max_ps(s, d);
+
+			_mm_storeu_ps(result, r);
+		}
+#else
+		template<BlendFactor FACTOR>
+		float blend_factor(const float *src, const float *dst, int channel) noexcept
+		{
+			if constexpr(FACTOR == BlendFactor::Zero)
+				return 0.0f;
+			else if constexpr(FACTOR == BlendFactor::One)
+				return 1.0f;
+			else if constexpr(FACTOR == BlendFactor::SrcColor)
+				return src[channel];
+			else if constexpr(FACTOR == BlendFactor::OneMinusSrcColor)
+				return 1.0f - src[channel];
+			else if constexpr(FACTOR == BlendFactor::DstColor)
+				return dst[channel];
+			else if constexpr(FACTOR == BlendFactor::OneMinusDstColor)
+				return 1.0f - dst[channel];
+			else if constexpr(FACTOR == BlendFactor::SrcAlpha)
+				return src[ALPHA_CHANNEL];
+			else if constexpr(FACTOR == BlendFactor::OneMinusSrcAlpha)
+				return 1.0f - src[ALPHA_CHANNEL];
+			else if constexpr(FACTOR == BlendFactor::DstAlpha)
+				return dst[ALPHA_CHANNEL];
+			else
+				return 1.0f - dst[ALPHA_CHANNEL];
+		}
+
+		template<BlendOp OP, BlendFactor SRC_FACTOR, BlendFactor DST_FACTOR>
+		void blend_equation(const float *src, const float *dst, float *result) noexcept
+		{
+			for(int i = 0; i < 4; i++)
+			{
+				float s = src[i];
+				float d = dst[i];
+				if constexpr(OP == BlendOp::Add)
+					result[i] = s * blend_factor<SRC_FACTOR>(src, dst, i) + d * blend_factor<DST_FACTOR>(src, dst, i);
+				else if constexpr(OP == BlendOp::Subtract)
+					result[i] = s * blend_factor<SRC_FACTOR>(src, dst, i) - d * blend_factor<DST_FACTOR>(src, dst, i);
+				else if constexpr(OP == BlendOp::ReverseSubtract)
+					result[i] = d * blend_factor<DST_FACTOR>(src, dst, i) - s * blend_factor<SRC_FACTOR>(src, dst, i);
+				else if constexpr(OP == BlendOp::Min)
+					result[i] = std::min(s, d);
+				else
+					result[i] = std::max(s, d);
+			}
+		}
+#endif
+
+		//equations of the op for every pair of factors, indexed by src_factor * BLEND_FACTOR_COUNT + dst_factor
+		template<BlendOp OP, std::size_t ...INDICES>
+		constexpr std::array<BlendEquationFunction, sizeof...(INDICES)> make_blend_equations(std::index_sequence<INDICES...>) noexcept
+		{
+			return {blend_equation<OP,
+								   static_cast<BlendFactor>(INDICES / BLEND_FACTOR_COUNT),
+								   static_cast<BlendFactor>(INDICES % BLEND_FACTOR_COUNT)>...};
+		}
+
+		template<BlendOp OP>
+		constexpr auto BLEND_EQUATIONS = make_blend_equations<OP>(std::make_index_sequence<BLEND_FACTOR_COUNT * BLEND_FACTOR_COUNT>{});
+	};
+
+	BlendEquationFunction GetBlendEquationFunction(BlendOp op, BlendFactor src_factor, BlendFactor dst_factor) noexcept
+	{
+		std::size_t index = static_cast<std::size_t>(src_factor) * BLEND_FACTOR_COUNT + static_cast<std::size_t>(dst_factor);
+		switch(op)
+		{
+			case BlendOp::Add:
+				return BLEND_EQUATIONS<BlendOp::Add>[index];
+				break;
+			case BlendOp::Subtract:
+				return BLEND_EQUATIONS<BlendOp::Subtract>[index];
+				break;
+			case BlendOp::ReverseSubtract:
+				return BLEND_EQUATIONS<BlendOp::ReverseSubtract>[index];
+				break;
+			case BlendOp::Min:
+				return blend_equation<BlendOp::Min, BlendFactor::One, BlendFactor::One>;
+				break;
+			default:
+				return blend_equation<BlendOp::Max, BlendFactor::One, BlendFactor::One>;
+				break;
+		}
+	}
+
+	ColorTarget MakeColorTarget(Image *image, const AttachmentBlendState &blend_state) noexcept
+	{
+		ColorTarget target{};
+		if(!image || !image->IsCreated())
+			return target;
+
+		target.format = image->GetFormat();
+		target.is_packed = get_channel_shifts(target.format, target.channel_shifts);
+		target.write_mask = 0;
+		for(int i = 0; i < 4; i++)
+			if(blend_state.write_mask & static_cast<ColorWriteMask>(1 << i))
+				target.write_mask |= std::uint32_t{0xFF} << target.channel_shifts[i];
+
+		if(blend_state.blend_enable)
+		{
+			target.color_blend = GetBlendEquationFunction(blend_state.color_op,
+														  blend_state.src_color_factor,
+														  blend_state.dst_color_factor);
+			target.alpha_blend = GetBlendEquationFunction(blend_state.alpha_op,
+														  blend_state.src_alpha_factor,
+														  blend_state.dst_alpha_factor);
+			if(target.alpha_blend == target.color_blend)
+				target.alpha_blend = nullptr;
+		}
+		else
+		{
+			target.color_blend = GetBlendEquationFunction(BlendOp::Add, BlendFactor::One, BlendFactor::Zero);
+			target.alpha_blend = nullptr;
+		}
+
+		target.is_opaque = !target.is_packed || (!blend_state.blend_enable && target.write_mask == ~std::uint32_t{0});
+		if(target.is_packed && target.write_mask == 0)
+			return ColorTarget{};
+
+		target.sample_pitch = GetFormatTexelSize(target.format);
+		target.texel_pitch = target.sample_pitch * image->GetSampleCount();
+		target.row_pitch = target.texel_pitch * image->GetWidth();
+		target.data = image->GetMappedPtr();
+
+		return target;
+	}
+
+	DepthTarget MakeDepthTarget(Image *image, bool depth_write_enable) noexcept
+	{
+		if(!image || !image->IsCreated() || !depth_write_enable)
+			return DepthTarget{};
+
+		std::size_t texel_size = GetFormatTexelSize(image->GetFormat());
+		return DepthTarget{.data = image->GetMappedPtr(),
+						   .row_pitch = texel_size * image->GetSampleCount() * image->GetWidth(),
+						   .texel_pitch = texel_size * image->GetSampleCount(),
+						   .sample_pitch = texel_size,
+						   .write = GetDepthWriteFunction(image->GetFormat())};
+	}
+
+	void BlendColor(const ColorTarget &target,
+					std::int64_t x,
+					std::int64_t y,
+					std::uint32_t sample_mask,
+					const hrs::math::glsl::vec4 &color) noexcept
+	{
+		//source color is clamped once for all samples
+		float src[4];
+		for(int i = 0; i < 4; i++)
+			src[i] = std::clamp(color[i], 0.0f, 1.0f);
+
+		for(; sample_mask; sample_mask &= sample_mask - 1)
+		{
+			std::byte *texel = target.GetTexel(x, y, std::countr_zero(sample_mask));
+			std::uint32_t dst_color = *reinterpret_cast<const std::uint32_t *>(texel);
+			float dst[4];
+			for(int i = 0; i < 4; i++)
+				dst[i] = static_cast<float>((dst_color >> target.channel_shifts[i]) & 0xFF) * (1.0f / 255);
+
+			float result[4];
+			target.color_blend(src, dst, result);
+			if(target.alpha_blend)
+			{
+				float alpha_result[4];
+				target.alpha_blend(src, dst, alpha_result);
+				result[ALPHA_CHANNEL] = alpha_result[ALPHA_CHANNEL];
+			}
+
+			std::uint32_t packed_color = 0;
+			for(int i = 0; i < 4; i++)
+				packed_color |= static_cast<std::uint32_t>(std::clamp(result[i], 0.0f, 1.0f) * 255) << target.channel_shifts[i];
+
+			*reinterpret_cast<std::uint32_t *>(texel) = (dst_color & ~target.write_mask) | (packed_color & target.write_mask);
+		}
+	}
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "DepthTest.h"
+#include "../hrs/flags.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace Renderer
+{
+	//maximal count of color attachments of a pipeline that may be configured by the state
+	constexpr inline std::size_t MAX_COLOR_ATTACHMENT_COUNT = 8;
+
+	enum class BlendFactor
+	{
+		Zero,
+		One,
+		SrcColor,
+		OneMinusSrcColor,
+		DstColor,
+		OneMinusDstColor,
+		SrcAlpha,
+		OneMinusSrcAlpha,
+		DstAlpha,
+		OneMinusDstAlpha
+	};
+
+	enum class BlendOp
+	{
+		Add,//src * src_factor + dst * dst_factor
+		Subtract,//src * src_factor - dst * dst_factor
+		ReverseSubtract,//dst * dst_factor - src * src_factor
+		Min,//factors are ignored
+		Max//factors are ignored
+	};
+
+	enum class ColorWriteMask
+	{
+		None = 0,
+		R = 1 << 0,
+		G = 1 << 1,
+		B = 1 << 2,
+		A = 1 << 3,
+		All = R | G | B | A
+	};
+
+	//blending of one color attachment. Source color is clamped to [0, 1] and
+	//color and alpha channels are blended with their own factors and operations.
+	//Blending and write masks apply to packed color formats, other formats are always stored
+	struct AttachmentBlendState
+	{
+		bool blend_enable;
+		BlendFactor src_color_factor;
+		BlendFactor dst_color_factor;
+		BlendOp color_op;
+		BlendFactor src_alpha_factor;
+		BlendFactor dst_alpha_factor;
+		BlendOp alpha_op;
+		hrs::flags<ColorWriteMask> write_mask;
+
+		constexpr AttachmentBlendState(bool _blend_enable = false,
+									   BlendFactor _src_color_factor = BlendFactor::One,
+									   BlendFactor _dst_color_factor = BlendFactor::Zero,
+									   BlendOp _color_op = BlendOp::Add,
+									   BlendFactor _src_alpha_factor = BlendFactor::One,
+									   BlendFactor _dst_alpha_factor = BlendFactor::Zero,
+									   BlendOp _alpha_op = BlendOp::Add,
+									   hrs::flags<ColorWriteMask> _write_mask = ColorWriteMask::All) noexcept
+			: blend_enable(_blend_enable),
+			  src_color_factor(_src_color_factor),
+			  dst_color_factor(_dst_color_factor),
+			  color_op(_color_op),
+			  src_alpha_factor(_src_alpha_factor),
+			  dst_alpha_factor(_dst_alpha_factor),
+			  alpha_op(_alpha_op),
+			  write_mask(_write_mask) {}
+	};
+
+	//"over" operator for straight(not premultiplied) alpha
+	constexpr inline AttachmentBlendState ALPHA_BLEND_STATE(true,
+															BlendFactor::SrcAlpha,
+															BlendFactor::OneMinusSrcAlpha,
+															BlendOp::Add,
+															BlendFactor::One,
+															BlendFactor::OneMinusSrcAlpha,
+															BlendOp::Add);
+
+	//blends rgba src with rgba dst into result, specialized for the op and the factors
+	using BlendEquationFunction = void (*)(const float *src, const float *dst, float *result) noexcept;
+
+	BlendEquationFunction GetBlendEquationFunction(BlendOp op, BlendFactor src_factor, BlendFactor dst_factor) noexcept;
+
+	//color attachment of a draw: image layout, format and blend equations are resolved once per draw,
+	//so writing a fragment is addressing and either a straight store or a blend
+	struct ColorTarget
+	{
+		std::byte *data;//nullptr if the attachment is not written
+		std::size_t row_pitch;
+		std::size_t texel_pitch;//all samples of a texel
+		std::size_t sample_pitch;
+		Format format;
+		bool is_packed;//packed 8 bit color format
+		bool is_opaque;//no blending and all channels are written
+		std::uint32_t channel_shifts[4];//bit offsets of r, g, b and a in the packed texel
+		std::uint32_t write_mask;//bits of the packed texel which are written
+		//equations of the color and alpha channels(One/Zero addition if blending is disabled),
+		//alpha_blend is nullptr if both channels use the same equation
+		BlendEquationFunction color_blend;
+		BlendEquationFunction alpha_blend;
+
+		std::byte * GetTexel(std::int64_t x, std::int64_t y, std::uint32_t sample) const noexcept
+		{
+			return data + y * row_pitch + x * texel_pitch + sample * sample_pitch;
+		}
+	};
+
+	//depth attachment of a draw
+	struct DepthTarget
+	{
+		std::byte *data;//nullptr if depth is not written
+		std::size_t row_pitch;
+		std::size_t texel_pitch;
+		std::size_t sample_pitch;
+		DepthWriteFunction write;//specialized for the depth format
+
+		std::byte * GetTexel(std::int64_t x, std::int64_t y, std::uint32_t sample) const noexcept
+		{
+			return data + y * row_pitch + x * texel_pitch + sample * sample_pitch;
+		}
+	};
+
+	//image may be null
+	ColorTarget MakeColorTarget(Image *image, const AttachmentBlendState &blend_state) noexcept;
+	DepthTarget MakeDepthTarget(Image *image, bool depth_write_enable) noexcept;
+
+	//encodes color for a packed format without the per texel format switch,
+	//channels are converted as by SetFormatImageColor
+	inline std::uint32_t PackColor(const ColorTarget &target, const hrs::math::glsl::vec4 &color) noexcept
+	{
+		std::uint32_t packed_color = 0;
+		for(int i = 0; i < 4; i++)
+			packed_color |= static_cast<std::uint32_t>(std::clamp(color[i], 0.0f, 1.0f) * 255) << target.channel_shifts[i];
+
+		return packed_color;
+	}
+
+	//blends color with the packed texels of the samples of the mask and writes channels of the write mask
+	void BlendColor(const ColorTarget &target,
+					std::int64_t x,
+					std::int64_t y,
+					std::uint32_t sample_mask,
+					const hrs::math::glsl::vec4 &color) noexcept;
+};
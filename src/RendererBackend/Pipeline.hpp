@@ -3,10 +3,24 @@
 #include "Framebuffer.h"
 #include "Viewport.h"
 #include "Polygon.hpp"
+#include "ThreadPool.h"
+#include "RasterKernels.h"
+#include "OutputMerger.h"
+#include "Meshlet.h"
+#include "OcclusionQuery.h"
+#include "PipelineStatistics.h"
+#include "../Profiler/Profiler.h"
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <bit>
+#include <cmath>
 #include <cassert>
+#include <cstring>
+#include <utility>
 #include "../hrs/flags.hpp"
 #include "../hrs/math/vector.hpp"
 
@@ -18,8 +32,37 @@ namespace Renderer
 	struct FragmentOutput
 	{
 		std::array<hrs::math::glsl::vec4, N> attachments;
+		float depth;//initialized with interpolated depth, read only with FragmentShaderFlags::DepthWrite
+		bool discard;//initialized with false, read only with FragmentShaderFlags::Discard
 	};
 
+	//declares what fragment shader may do besides writing attachments
+	enum class FragmentShaderFlags
+	{
+		None = 0,
+		Discard = 1 << 0,
+		DepthWrite = 1 << 1,
+		Derivatives = 1 << 2//shader reads derivatives of the attributes, triangles are rasterized in 2x2 quads
+	};
+
+	enum class DepthTestMode
+	{
+		Early,//only the depth test runs before the fragment shader, the interpolated depth is written after it
+		EarlyTestLateWrite,//same as Early, but the write is skipped for discarded fragments(shader may discard)
+		Late//depth is tested and written after the fragment shader(shader may write depth)
+	};
+
+	constexpr DepthTestMode GetDepthTestMode(hrs::flags<FragmentShaderFlags> flags) noexcept
+	{
+		if(flags & FragmentShaderFlags::DepthWrite)
+			return DepthTestMode::Late;
+
+		if(flags & FragmentShaderFlags::Discard)
+			return DepthTestMode::EarlyTestLateWrite;
+
+		return DepthTestMode::Early;
+	}
+
 	enum class RasterizationTopology
 	{
 		Line,
@@ -41,54 +84,167 @@ namespace Renderer
 
 	struct State
 	{
+		constexpr static float DEFAULT_GUARD_BAND = 4.0f;
+
 		RasterizationTopology topology;
 		bool depth_test_enable;
 		Viewport viewport;
 		CullSide cull_side;
 		CullOrder cull_order;
+		//X/Y clip planes are at +-guard_band * w, triangles inside the guard band are not clipped
+		//geometrically and are only scissored by the rasterizer. Must be >= 1.
+		//It is narrowed per draw, so the guard band of a large viewport stays inside of MAX_SCREEN_COORDINATE
+		float guard_band;
+		//depth of passed fragments is written to the depth image(if any) regardless of depth_test_enable
+		bool depth_write_enable;
+		//LessOrEqual for forward z, GreaterOrEqual for reversed z
+		CompareOp depth_compare;
+		//output merger state of the color attachments by their index
+		std::array<AttachmentBlendState, MAX_COLOR_ATTACHMENT_COUNT> blend_states;
+		//rasterization is limited to the intersection of the viewport and the scissor
+		bool scissor_enable;
+		Scissor scissor;
+		//if disabled, primitives are not clipped and every vertex must be inside of the clip volume
+		//(e.g. bounds of the drawn object are completely inside of the frustum)
+		bool clipping_enable;
 
 		constexpr State(RasterizationTopology _topology = {},
 						bool _depth_test_enable = {},
 						const Viewport &_viewport = {},
 						CullSide _cull_side = {},
-						CullOrder _cull_order = {}) noexcept
+						CullOrder _cull_order = {},
+						float _guard_band = DEFAULT_GUARD_BAND,
+						bool _depth_write_enable = true,
+						CompareOp _depth_compare = CompareOp::LessOrEqual,
+						bool _scissor_enable = false,
+						const Scissor &_scissor = {},
+						bool _clipping_enable = true) noexcept
 			: topology(_topology),
 			  depth_test_enable(_depth_test_enable),
 			  viewport(_viewport),
 			  cull_side(_cull_side),
-			  cull_order(_cull_order) {}
+			  cull_order(_cull_order),
+			  guard_band(_guard_band),
+			  depth_write_enable(_depth_write_enable),
+			  depth_compare(_depth_compare),
+			  blend_states{},
+			  scissor_enable(_scissor_enable),
+			  scissor(_scissor),
+			  clipping_enable(_clipping_enable) {}
 	};
 
-	template<LinearInterpolatable VO/*vertex output*/, std::size_t ATTACHMENT_COUNT, typename SD>
-	class Pipeline
+	//meshlet bounds are tested in the space of the frustum planes and the camera position(e.g. model space)
+	struct MeshletCullData
 	{
-	public:
+		hrs::math::frustum<float> frustum;
+		hrs::math::glsl::vec3 camera_position;
+		//screen winding of triangles whose normal cross(v1 - v0, v2 - v0) points to the camera,
+		//it is flipped by transformations which mirror the geometry
+		CullOrder facing_order;
+	};
+
+	//triangles adjacent to the segments of a line list(e.g. faces of mesh edges for wireframe)
+	struct LineFaceData
+	{
+		const std::uint32_t *index_data;//triangle list
+		//two triangles of index_data per segment(parallel to the line indices),
+		//a segment with a single face repeats it
+		const std::uint32_t *faces;
+	};
 
-		using VertexShader = hrs::math::glsl::vec4(std::uint32_t vertex_index,
+	struct VertexCacheStatistics
+	{
+		std::size_t index_count;
+		std::size_t transformed_vertex_count;
+
+		//count of vertex shader invocations per index, 1.0 means no reuse at all
+		constexpr float GetTransformRatio() const noexcept
+		{
+			if(index_count == 0)
+				return 0.0f;
+
+			return static_cast<float>(transformed_vertex_count) / index_count;
+		}
+	};
+
+	//instance_index is 0 and instance input is nullptr for non instanced draws
+	template<typename VO, typename SD>
+	using VertexShaderType = hrs::math::glsl::vec4(std::uint32_t vertex_index,
+												   std::uint32_t instance_index,
 												   const std::byte */*vertex input*/,
+												   const std::byte */*instance input*/,
 												   VO &/*vertex output*/,
 												   SD &/*shader_data*/);
 
-		using FragmentShader = void(const VO &/*vertex output*/,
+	//screen space derivatives of the interpolated attributes: differences between pixels of the 2x2 quad
+	//that contains the fragment(coarse derivatives). Uncovered pixels of the quad are helpers: they are
+	//interpolated for the derivatives but not shaded. Zero for lines and without FragmentShaderFlags::Derivatives
+	template<typename VO>
+	struct FragmentDerivatives
+	{
+		VO ddx;
+		VO ddy;
+	};
+
+	template<typename VO, std::size_t ATTACHMENT_COUNT, typename SD>
+	using FragmentShaderType = void(const VO &/*vertex output*/,
+									const FragmentDerivatives<VO> &/*derivatives*/,
 									const hrs::math::vector<std::int64_t, 2> &/*frag_position*/,
 									float /*frag_depth*/,
 									FragmentOutput<ATTACHMENT_COUNT> &/*fragment output*/,
 									SD &/*shader_data*/);
 
-		template<std::invocable<std::uint32_t, const std::byte *, VO &, SD &> V,
+	//pipeline with shaders bound at compile time: VS and FS are concrete callable types,
+	//so shader calls are inlined into the vertex and rasterization loops
+	template<LinearInterpolatable VO/*vertex output*/, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	class StaticPipeline
+	{
+		static_assert(ATTACHMENT_COUNT <= MAX_COLOR_ATTACHMENT_COUNT);
+	public:
+
+		using VertexShader = VertexShaderType<VO, SD>;
+		using FragmentShader = FragmentShaderType<VO, ATTACHMENT_COUNT, SD>;
+
+		//screen is split into TILE_SIZE x TILE_SIZE tiles when pipeline draws with a thread pool
+		constexpr static std::int64_t TILE_SIZE = 64;
+		//minimal count of triangles processed by one thread in the geometry stage
+		constexpr static std::size_t MIN_GEOMETRY_CHUNK_SIZE = 256;
+		//minimal count of vertices transformed by one thread before indexed primitive assembly
+		constexpr static std::size_t MIN_VERTEX_CHUNK_SIZE = 512;
+		//indexed instanced draws are split into batches of instances whose vertices fit into the vertex cache
+		constexpr static std::size_t MAX_VERTEX_CACHE_SIZE = 1 << 16;
+		//screen space vertices are snapped to 16.8 fixed point in the viewport transform
+		constexpr static std::int64_t SUB_PIXEL_BITS = 8;
+		constexpr static std::int64_t SUB_PIXEL_SCALE = std::int64_t{1} << SUB_PIXEL_BITS;
+		//clipped primitives never reach +-MAX_SCREEN_COORDINATE pixels(see get_guard_band),
+		//primitives with vertices beyond it(not clipped or NaN) are dropped by the setup
+		constexpr static float MAX_SCREEN_COORDINATE = static_cast<float>(std::int64_t{1} << (23 - SUB_PIXEL_BITS));
+		//rotated grid sample positions of multisampled framebuffers in sub pixel units from the pixel center
+		constexpr static std::int64_t SAMPLE_OFFSETS[MAX_SAMPLE_COUNT][2] = {{-32, -96}, {96, -32}, {-96, 32}, {32, 96}};
+		constexpr static std::int32_t MAX_SAMPLE_OFFSET = 96;
+
+		//_fragment_shader_flags select the depth test mode: early z is used unless
+		//fragment shader may discard fragments or write depth.
+		//If _thread_pool is not null pipeline works in sort-middle mode:
+		//triangles are binned into screen tiles and tiles are rasterized in parallel.
+		//In this mode shaders are invoked concurrently with the same shader data
+		template<std::invocable<std::uint32_t, std::uint32_t, const std::byte *, const std::byte *, VO &, SD &> V,
 				 std::invocable<const VO &,
+								 const FragmentDerivatives<VO> &,
 								 const hrs::math::vector<std::int64_t, 2> &,
 								 float,
 								 FragmentOutput<ATTACHMENT_COUNT> &,
 								 SD &> F>
-		Pipeline(std::size_t _vertex_data_stride,
-				 V &&_vertex_shader,
-				 F &&_fragment_shader);
+		StaticPipeline(std::size_t _vertex_data_stride,
+					   V &&_vertex_shader,
+					   F &&_fragment_shader,
+					   hrs::flags<FragmentShaderFlags> _fragment_shader_flags = FragmentShaderFlags::None,
+					   ThreadPool *_thread_pool = nullptr);
 
-		Pipeline(const Pipeline &) = delete;
-		Pipeline(Pipeline &&ppl) noexcept;
-		Pipeline & operator=(const Pipeline &) = delete;
-		Pipeline & operator=(Pipeline &&ppl) noexcept;
+		StaticPipeline(const StaticPipeline &) = delete;
+		StaticPipeline(StaticPipeline &&ppl) noexcept;
+		StaticPipeline & operator=(const StaticPipeline &) = delete;
+		StaticPipeline & operator=(StaticPipeline &&ppl) noexcept;
 
 		void Draw(Framebuffer &fb,
 				  const std::byte *vertex_data,
@@ -102,369 +258,2208 @@ namespace Renderer
 						 std::size_t count,
 						 const State &state,
 						 SD &shader_data);
+
+		//draws count vertices instance_count times, vertex shader of the instance i gets
+		//instance_index i and instance input at instance_data + i * instance_data_stride(nullptr if instance_data is null).
+		//Primitives of all instances are spread across the thread pool as one draw
+		void DrawInstanced(Framebuffer &fb,
+						   const std::byte *vertex_data,
+						   std::size_t count,
+						   const std::byte *instance_data,
+						   std::size_t instance_data_stride,
+						   std::uint32_t instance_count,
+						   const State &state,
+						   SD &shader_data);
+
+		void DrawIndexedInstanced(Framebuffer &fb,
+								  const std::byte *vertex_data,
+								  const std::uint32_t *index_data,
+								  std::size_t count,
+								  const std::byte *instance_data,
+								  std::size_t instance_data_stride,
+								  std::uint32_t instance_count,
+								  const State &state,
+								  SD &shader_data);
+
+		//draws a line list: every two indices form a segment(e.g. unique edges of a mesh for wireframe).
+		//Segments have no facing, so topology and culling of the state are ignored
+		void DrawIndexedLines(Framebuffer &fb,
+							  const std::byte *vertex_data,
+							  const std::uint32_t *index_data,
+							  std::size_t count,
+							  const State &state,
+							  SD &shader_data);
+
+		//segment is skipped if the state culls all of its faces(same test as for the triangles of the faces),
+		//so edges of a mesh are drawn like outlines of its culled triangles
+		void DrawIndexedLines(Framebuffer &fb,
+							  const std::byte *vertex_data,
+							  const std::uint32_t *index_data,
+							  std::size_t count,
+							  const LineFaceData &face_data,
+							  const State &state,
+							  SD &shader_data);
+
+		//indexed triangle list split into meshlets(index offsets of meshlets are relative to index_data).
+		//Meshlets outside of the frustum or facing away from the camera(if the state culls such triangles)
+		//are skipped before the vertex shading, the rest is drawn as a single indexed draw
+		void DrawIndexedMeshlets(Framebuffer &fb,
+								 const std::byte *vertex_data,
+								 const std::uint32_t *index_data,
+								 const Meshlet *meshlets,
+								 std::size_t meshlet_count,
+								 const MeshletCullData &cull_data,
+								 const State &state,
+								 SD &shader_data);
+
+		DepthTestMode GetDepthTestMode() const noexcept;
+
+		//indexed draws shade every referenced vertex once per instance, statistics are accumulated until reset
+		const VertexCacheStatistics & GetVertexCacheStatistics() const noexcept;
+		void ResetVertexCacheStatistics() noexcept;
+
+		//samples which pass the depth test in the following draws are counted by the query until
+		//EndOcclusionQuery. Query must stay valid until then, beginning another query ends the active one
+		void BeginOcclusionQuery(OcclusionQuery &query) noexcept;
+		void EndOcclusionQuery() noexcept;
+
+		//counters of all draws since the last reset, zero unless PIPELINE_STATISTICS_ENABLED
+		const PipelineStatistics & GetStatistics() const noexcept;
+		void ResetStatistics() noexcept;
 	private:
 
-		Polygon<VO> vertex_shader_evaluation(const std::byte *vertex_data,
-											 const std::uint32_t *index_data,
-											 std::size_t index,
-											 SD &shader_data);
+		//counters of one thread of the pool(or of the calling thread without it) during a draw,
+		//aligned so threads never write the same cache line. Merged when the draw is finished
+		struct alignas(64) ThreadCounters
+		{
+			std::uint64_t passed_samples;
+			PipelineStatistics statistics;
+		};
+
+		struct ScreenRect
+		{
+			std::int64_t min_x;
+			std::int64_t min_y;
+			std::int64_t max_x;
+			std::int64_t max_y;
+
+			bool IsEmpty() const noexcept
+			{
+				return min_x > max_x || min_y > max_y;
+			}
+
+			bool IsInside(const hrs::math::vector<std::int64_t, 2> &position) const noexcept
+			{
+				return position[0] >= min_x && position[0] <= max_x &&
+					   position[1] >= min_y && position[1] <= max_y;
+			}
+		};
+
+		//screen space triangle that survived culling
+		struct TriangleSetup
+		{
+			constexpr static std::size_t VERTEX_COUNT = 3;
+
+			Polygon<VO> polygon;//winding is made positive for the edge functions
+			std::int32_t x[3];//16.8 fixed point window coordinates of the vertices
+			std::int32_t y[3];
+			std::int64_t area;//doubled area in sub pixel units, always positive
+			ScreenRect rect;//pixels that may be covered by the triangle
+		};
+
+		//screen space segment of a line list
+		struct LineSetup
+		{
+			constexpr static std::size_t VERTEX_COUNT = 2;
+
+			Vertex<VO> vertices[2];
+			std::int32_t x[2];//16.8 fixed point window coordinates of the vertices
+			std::int32_t y[2];
+			ScreenRect rect;//pixels that may be covered by the segment
+		};
+
+		//vertex and instance streams of a draw
+		struct DrawInput
+		{
+			const std::byte *vertex_data;
+			const std::uint32_t *index_data;//nullptr for non indexed draws
+			std::size_t count;//count of vertices(indices) of one instance
+			const std::byte *instance_data;
+			std::size_t instance_data_stride;
+			std::uint32_t instance_count;
+			//faces of the segments of indexed line draws(nullptr if segments are not culled),
+			//their vertices are cached along with the vertices of the segments
+			const std::uint32_t *face_index_data = nullptr;
+			const std::uint32_t *faces = nullptr;
+		};
+
+		struct GeometryChunk
+		{
+			std::vector<TriangleSetup> triangles;
+			std::vector<LineSetup> lines;
+			std::vector<std::vector<std::uint32_t>> tile_bins;//indices of primitives in submission order
 
-		void clipping_evaluation(Polygon<VO> polygon,
-								 hrs::flags<ClipPlane> planes,
-								 Framebuffer &fb,
+			template<typename P>
+			std::vector<P> & GetPrimitives() noexcept
+			{
+				if constexpr(std::same_as<P, TriangleSetup>)
+					return triangles;
+				else
+					return lines;
+			}
+		};
+
+		//viewport clipped by extents of the framebuffer images,
+		//rasterizers address images inside of it without bounds checks
+		static ScreenRect get_draw_rect(const Framebuffer &fb, const State &state) noexcept;
+		static ScreenRect get_polygon_rect(const Polygon<VO> &polygon) noexcept;
+		//state.guard_band of each axis narrowed, so the guard band of the viewport stays inside of +-MAX_SCREEN_COORDINATE
+		static hrs::math::glsl::vec2 get_guard_band(const State &state) noexcept;
+
+		//P is TriangleSetup or LineSetup.
+		//Draw rect is computed once per draw, instances are processed in batches that fit into the vertex cache
+		template<typename P>
+		void draw(Framebuffer &fb, const DrawInput &input, const State &state, SD &shader_data);
+
+		//primitives of instances [first_instance, first_instance + instance_count) form a single range
+		template<typename P>
+		void draw_immediate(Framebuffer &fb,
+							const DrawInput &input,
+							std::uint32_t first_instance,
+							std::uint32_t instance_count,
+							const ScreenRect &draw_rect,
+							const State &state,
+							SD &shader_data);
+
+		template<typename P>
+		void draw_binned(Framebuffer &fb,
+						 const DrawInput &input,
+						 std::uint32_t first_instance,
+						 std::uint32_t instance_count,
+						 const ScreenRect &draw_rect,
+						 const State &state,
+						 SD &shader_data);
+
+		//finds referenced index range of the draw, returns its size
+		std::size_t vertex_cache_references_evaluation(const DrawInput &input);
+
+		void vertex_cache_evaluation(const DrawInput &input,
+									 std::uint32_t first_instance,
+									 std::uint32_t instance_count,
+									 SD &shader_data);
+
+		hrs::math::glsl::vec4 vertex_shader_invocation(const DrawInput &input,
+													   std::uint32_t vertex_index,
+													   std::uint32_t instance_index,
+													   VO &vertex_output,
+													   SD &shader_data,
+													   ThreadCounters &counters);
+
+		const Vertex<VO> & cached_vertex(std::uint32_t vertex_index, std::uint32_t instance_index) const noexcept;
+
+		//indexed vertices are read from the vertex cache filled by vertex_cache_evaluation
+		Vertex<VO> vertex_fetch(const DrawInput &input,
+								std::size_t index,
+								std::uint32_t instance_index,
+								SD &shader_data,
+								ThreadCounters &counters);
+
+		//assembles primitive from P::VERTEX_COUNT vertices starting from index of the instance,
+		//primitives which survived clipping and culling are appended to output
+		void primitive_evaluation(const DrawInput &input,
+								  std::size_t index,
+								  std::uint32_t instance_index,
+								  const State &state,
+								  SD &shader_data,
+								  std::vector<TriangleSetup> &output,
+								  ThreadCounters &counters);
+
+		void primitive_evaluation(const DrawInput &input,
+								  std::size_t index,
+								  std::uint32_t instance_index,
+								  const State &state,
+								  SD &shader_data,
+								  std::vector<LineSetup> &output,
+								  ThreadCounters &counters);
+
+		void clipping_evaluation(const Polygon<VO> &polygon,
 								 const State &state,
-								 SD &shader_data);
+								 std::vector<TriangleSetup> &output,
+								 ThreadCounters &counters);
+
+		void homogenous_division(Vertex<VO> &vertex);
+
+		//clipped vertices are inside of the guard band, but intersections close to the W plane lose
+		//precision in the division, so projected X/Y of clipped draws are clamped to it
+		void guard_band_clamp(Vertex<VO> &vertex) const noexcept;
+
+		void viewport_transform(Vertex<VO> &vertex, const Viewport &viewport);
 
-		void homogenous_division(Polygon<VO> &polygon);
+		//doubled signed area of the triangle in sub pixel units, negative for clockwise winding on the screen
+		static std::int64_t get_fixed_point_area(const std::int32_t *fixed_x, const std::int32_t *fixed_y) noexcept;
+		static bool is_area_culled(std::int64_t area, const State &state) noexcept;
 
-		void viewport_transform(Polygon<VO> &polygon, const Viewport &viewport);
+		bool triangle_setup(const Polygon<VO> &polygon, const State &state, TriangleSetup &setup) noexcept;
 
-		bool culling_evaluation(CullSide cull_side, CullOrder cull_order, const Polygon<VO> &polygon) noexcept;
+		//true if any triangle the face is clipped into would pass the culling of triangle_setup
+		bool is_face_visible(const DrawInput &input,
+							 std::uint32_t face,
+							 std::uint32_t instance_index,
+							 const State &state) noexcept;
+
+		bool line_setup(const Vertex<VO> &start, const Vertex<VO> &end, const State &state, LineSetup &setup) noexcept;
 
 		bool is_depth_test_passed(const Image *depth_image,
 								  const hrs::math::vector<std::int64_t, 2> &position,
+								  std::uint32_t sample,
 								  float test_z) const noexcept;
 
-		void rasterization_line_brezenham(const Polygon<VO> &polygon,
+		void rasterization(const TriangleSetup &setup,
+						   Framebuffer &fb,
+						   const State &state,
+						   const ScreenRect &rect,
+						   SD &shader_data,
+						   ThreadCounters &counters);
+
+		void rasterization(const LineSetup &setup,
+						   Framebuffer &fb,
+						   const State &state,
+						   const ScreenRect &rect,
+						   SD &shader_data,
+						   ThreadCounters &counters);
+
+		//start and end are pixels of the segment ends, the end pixel is not written
+		void rasterization_line_brezenham(const Vertex<VO> &start_vertex,
+										  const Vertex<VO> &end_vertex,
+										  const std::int64_t (&start)[2],
+										  const std::int64_t (&end)[2],
 										  Framebuffer &fb,
+										  const ScreenRect &rect,
 										  bool depth_test_enable,
-										  SD &shader_data);
+										  SD &shader_data,
+										  ThreadCounters &counters);
 
-		void rasterization_fill(const Polygon<VO> &polygon,
+		void rasterization_fill(const TriangleSetup &setup,
 								Framebuffer &fb,
+								const ScreenRect &rect,
 								bool depth_test_enable,
-								SD &shader_data);
-
-		void set_framebuffer_output(Framebuffer &fb,
-									const hrs::math::vector<std::int64_t, 2> &position,
+								SD &shader_data,
+								ThreadCounters &counters);
+
+		//statistics only: counts covered lanes of the block which are not in passed_mask
+		void count_depth_rejected_fragments(const RasterSpan &span,
+											const RasterBlockStart &block,
+											std::uint32_t lane_count,
+											std::uint32_t passed_mask,
+											ThreadCounters &counters) const noexcept;
+
+		//fragment is shaded once for all samples of sample_mask, sample_depth holds depth of every sample in the mask
+		bool fragment_evaluation(const Image *late_depth_image,
+								 const hrs::math::vector<std::int64_t, 2> &position,
+								 std::uint32_t sample_mask,
+								 const float *sample_depth,
+								 const VO &attributes,
+								 const FragmentDerivatives<VO> &derivatives,
+								 float depth,
+								 FragmentOutput<ATTACHMENT_COUNT> &fragment_output,
+								 SD &shader_data,
+								 ThreadCounters &counters);
+
+		//specializes kernels and per sample tests for the compare op and the depth format of the draw
+		void depth_test_setup(Framebuffer &fb, const State &state);
+
+		//resolves attachments of the framebuffer for the output merger once per draw
+		void output_merger_setup(Framebuffer &fb, const State &state);
+
+		//returns true if depth has been written
+		bool set_framebuffer_output(const hrs::math::vector<std::int64_t, 2> &position,
+									std::uint32_t sample_mask,
 									const FragmentOutput<ATTACHMENT_COUNT> &output,
-									float depth);
+									const float *sample_depth,
+									ThreadCounters &counters);
 
 
 		std::size_t vertex_data_stride;
-		std::function<VertexShader> vertex_shader;
-		std::function<FragmentShader> fragment_shader;
+		VS vertex_shader;
+		FS fragment_shader;
+		DepthTestMode depth_test_mode;
+		bool is_quad_rasterization;
+		ThreadPool *thread_pool;
+		RasterBlockKernel raster_block_kernel;
+		CompareOp depth_compare;//Always if depth test is disabled
+		Format depth_format;
+		DepthTestFunction depth_test_function;
+		//distance of the farthest sample from the pixel center for the framebuffer of the current draw
+		std::int32_t sample_reach;
+		//X/Y clip planes of the current draw
+		hrs::math::glsl::vec2 guard_band;
+		std::array<ColorTarget, ATTACHMENT_COUNT> color_targets;
+		DepthTarget depth_target;
+
+		GeometryChunk immediate_chunk;//primitives of a single input primitive in the immediate mode
+		std::vector<GeometryChunk> geometry_chunks;
+
+		std::uint32_t vertex_cache_first_index;
+		std::uint32_t vertex_cache_first_instance;
+		std::size_t vertex_cache_range;//cached vertices of one instance
+		std::vector<Vertex<VO>> vertex_cache;
+		std::vector<std::uint8_t> vertex_cache_references;
+		VertexCacheStatistics vertex_cache_statistics;
+		std::vector<std::uint32_t> meshlet_index_data;//indices of meshlets which passed culling
+
+		std::vector<ThreadCounters> thread_counters;
+		OcclusionQuery *occlusion_query;
+		PipelineStatistics statistics;
 	};
 
-	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD>
-	template<std::invocable<std::uint32_t, const std::byte *, VO &, SD &> V,
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	template<std::invocable<std::uint32_t, std::uint32_t, const std::byte *, const std::byte *, VO &, SD &> V,
 			  std::invocable<const VO &,
+							 const FragmentDerivatives<VO> &,
 							 const hrs::math::vector<std::int64_t, 2> &,
 							 float,
 							 FragmentOutput<ATTACHMENT_COUNT> &,
 							 SD &> F>
-	Pipeline<VO, ATTACHMENT_COUNT, SD>::Pipeline(std::size_t _vertex_data_stride,
-				 V &&_vertex_shader,
-				 F &&_fragment_shader)
+	StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::StaticPipeline(std::size_t _vertex_data_stride,
+																	 V &&_vertex_shader,
+																	 F &&_fragment_shader,
+																	 hrs::flags<FragmentShaderFlags> _fragment_shader_flags,
+																	 ThreadPool *_thread_pool)
 		: vertex_data_stride(_vertex_data_stride),
-		  vertex_shader(_vertex_shader),
-		  fragment_shader(_fragment_shader) {}
-
-	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD>
-	Pipeline<VO, ATTACHMENT_COUNT, SD>::Pipeline(Pipeline &&ppl) noexcept
+		  vertex_shader(std::forward<V>(_vertex_shader)),
+		  fragment_shader(std::forward<F>(_fragment_shader)),
+		  depth_test_mode(Renderer::GetDepthTestMode(_fragment_shader_flags)),
+		  is_quad_rasterization(static_cast<bool>(_fragment_shader_flags & FragmentShaderFlags::Derivatives)),
+		  thread_pool(_thread_pool),
+		  raster_block_kernel(GetRasterBlockKernel()),
+		  depth_compare(CompareOp::LessOrEqual),
+		  depth_format(Format::DEPTH32_SFLOAT),
+		  depth_test_function(GetDepthTestFunction(CompareOp::LessOrEqual, Format::DEPTH32_SFLOAT)),
+		  sample_reach(0),
+		  guard_band(State::DEFAULT_GUARD_BAND, State::DEFAULT_GUARD_BAND),
+		  color_targets{},
+		  depth_target{},
+		  vertex_cache_first_index(0),
+		  vertex_cache_first_instance(0),
+		  vertex_cache_range(0),
+		  vertex_cache_statistics{},
+		  thread_counters(_thread_pool ? _thread_pool->GetThreadCount() : 1),
+		  occlusion_query(nullptr),
+		  statistics{} {}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::StaticPipeline(StaticPipeline &&ppl) noexcept
 		: vertex_data_stride(ppl.vertex_data_stride),
 		  vertex_shader(std::move(ppl.vertex_shader)),
-		  fragment_shader(std::move(ppl.fragment_shader)) {}
-
-	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD>
-	Pipeline<VO, ATTACHMENT_COUNT, SD> & Pipeline<VO, ATTACHMENT_COUNT, SD>::operator=(Pipeline &&ppl) noexcept
+		  fragment_shader(std::move(ppl.fragment_shader)),
+		  depth_test_mode(ppl.depth_test_mode),
+		  is_quad_rasterization(ppl.is_quad_rasterization),
+		  thread_pool(ppl.thread_pool),
+		  raster_block_kernel(ppl.raster_block_kernel),
+		  depth_compare(ppl.depth_compare),
+		  depth_format(ppl.depth_format),
+		  depth_test_function(ppl.depth_test_function),
+		  sample_reach(ppl.sample_reach),
+		  guard_band(ppl.guard_band),
+		  color_targets(ppl.color_targets),
+		  depth_target(ppl.depth_target),
+		  immediate_chunk(std::move(ppl.immediate_chunk)),
+		  geometry_chunks(std::move(ppl.geometry_chunks)),
+		  vertex_cache_first_index(ppl.vertex_cache_first_index),
+		  vertex_cache_first_instance(ppl.vertex_cache_first_instance),
+		  vertex_cache_range(ppl.vertex_cache_range),
+		  vertex_cache(std::move(ppl.vertex_cache)),
+		  vertex_cache_references(std::move(ppl.vertex_cache_references)),
+		  vertex_cache_statistics(ppl.vertex_cache_statistics),
+		  meshlet_index_data(std::move(ppl.meshlet_index_data)),
+		  thread_counters(std::move(ppl.thread_counters)),
+		  occlusion_query(std::exchange(ppl.occlusion_query, nullptr)),
+		  statistics(ppl.statistics) {}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS> &
+	StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::operator=(StaticPipeline &&ppl) noexcept
 	{
 		vertex_data_stride = ppl.vertex_data_stride;
 		vertex_shader = std::move(ppl.vertex_shader);
 		fragment_shader = std::move(ppl.fragment_shader);
+		depth_test_mode = ppl.depth_test_mode;
+		is_quad_rasterization = ppl.is_quad_rasterization;
+		thread_pool = ppl.thread_pool;
+		raster_block_kernel = ppl.raster_block_kernel;
+		depth_compare = ppl.depth_compare;
+		depth_format = ppl.depth_format;
+		depth_test_function = ppl.depth_test_function;
+		sample_reach = ppl.sample_reach;
+		guard_band = ppl.guard_band;
+		color_targets = ppl.color_targets;
+		depth_target = ppl.depth_target;
+		immediate_chunk = std::move(ppl.immediate_chunk);
+		geometry_chunks = std::move(ppl.geometry_chunks);
+		vertex_cache_first_index = ppl.vertex_cache_first_index;
+		vertex_cache_first_instance = ppl.vertex_cache_first_instance;
+		vertex_cache_range = ppl.vertex_cache_range;
+		vertex_cache = std::move(ppl.vertex_cache);
+		vertex_cache_references = std::move(ppl.vertex_cache_references);
+		vertex_cache_statistics = ppl.vertex_cache_statistics;
+		meshlet_index_data = std::move(ppl.meshlet_index_data);
+		thread_counters = std::move(ppl.thread_counters);
+		occlusion_query = std::exchange(ppl.occlusion_query, nullptr);
+		statistics = ppl.statistics;
 
 		return *this;
 	}
 
-	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD>
-	void Pipeline<VO, ATTACHMENT_COUNT, SD>::Draw(Framebuffer &fb,
-												  const std::byte *vertex_data,
-												  std::size_t count,
-												  const State &state,
-												  SD &shader_data)
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::Draw(Framebuffer &fb,
+																const std::byte *vertex_data,
+																std::size_t count,
+																const State &state,
+																SD &shader_data)
+	{
+		DrawInstanced(fb, vertex_data, count, nullptr, 0, 1, state, shader_data);
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::DrawIndexed(Framebuffer &fb,
+																	   const std::byte *vertex_data,
+																	   const std::uint32_t *index_data,
+																	   std::size_t count,
+																	   const State &state,
+																	   SD &shader_data)
+	{
+		DrawIndexedInstanced(fb, vertex_data, index_data, count, nullptr, 0, 1, state, shader_data);
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::DrawInstanced(Framebuffer &fb,
+																		 const std::byte *vertex_data,
+																		 std::size_t count,
+																		 const std::byte *instance_data,
+																		 std::size_t instance_data_stride,
+																		 std::uint32_t instance_count,
+																		 const State &state,
+																		 SD &shader_data)
 	{
 		assert(count % 3 == 0);
-		for(std::size_t i = 0; i < count; i += 3)
+		DrawInput input{.vertex_data = vertex_data,
+						.index_data = nullptr,
+						.count = count,
+						.instance_data = instance_data,
+						.instance_data_stride = instance_data_stride,
+						.instance_count = instance_count};
+
+		draw<TriangleSetup>(fb, input, state, shader_data);
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::DrawIndexedInstanced(Framebuffer &fb,
+																				const std::byte *vertex_data,
+																				const std::uint32_t *index_data,
+																				std::size_t count,
+																				const std::byte *instance_data,
+																				std::size_t instance_data_stride,
+																				std::uint32_t instance_count,
+																				const State &state,
+																				SD &shader_data)
+	{
+		assert(count % 3 == 0);
+		DrawInput input{.vertex_data = vertex_data,
+						.index_data = index_data,
+						.count = count,
+						.instance_data = instance_data,
+						.instance_data_stride = instance_data_stride,
+						.instance_count = instance_count};
+
+		draw<TriangleSetup>(fb, input, state, shader_data);
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::DrawIndexedLines(Framebuffer &fb,
+																			const std::byte *vertex_data,
+																			const std::uint32_t *index_data,
+																			std::size_t count,
+																			const State &state,
+																			SD &shader_data)
+	{
+		assert(count % 2 == 0);
+		DrawInput input{.vertex_data = vertex_data,
+						.index_data = index_data,
+						.count = count,
+						.instance_data = nullptr,
+						.instance_data_stride = 0,
+						.instance_count = 1};
+
+		draw<LineSetup>(fb, input, state, shader_data);
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::DrawIndexedLines(Framebuffer &fb,
+																			const std::byte *vertex_data,
+																			const std::uint32_t *index_data,
+																			std::size_t count,
+																			const LineFaceData &face_data,
+																			const State &state,
+																			SD &shader_data)
+	{
+		//faces are not needed if nothing is culled, so their vertices are not shaded
+		if(state.cull_side == CullSide::None)
 		{
-			auto polygon = vertex_shader_evaluation(vertex_data, nullptr, i, shader_data);
-			clipping_evaluation(polygon, {}, fb, state, shader_data);
+			DrawIndexedLines(fb, vertex_data, index_data, count, state, shader_data);
+			return;
 		}
+
+		assert(count % 2 == 0);
+		DrawInput input{.vertex_data = vertex_data,
+						.index_data = index_data,
+						.count = count,
+						.instance_data = nullptr,
+						.instance_data_stride = 0,
+						.instance_count = 1,
+						.face_index_data = face_data.index_data,
+						.faces = face_data.faces};
+
+		draw<LineSetup>(fb, input, state, shader_data);
 	}
 
-	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD>
-	void Pipeline<VO, ATTACHMENT_COUNT, SD>::DrawIndexed(Framebuffer &fb,
-														 const std::byte *vertex_data,
-														 const std::uint32_t *index_data,
-														 std::size_t count,
-														 const State &state,
-														 SD &shader_data)
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::DrawIndexedMeshlets(Framebuffer &fb,
+																			   const std::byte *vertex_data,
+																			   const std::uint32_t *index_data,
+																			   const Meshlet *meshlets,
+																			   std::size_t meshlet_count,
+																			   const MeshletCullData &cull_data,
+																			   const State &state,
+																			   SD &shader_data)
 	{
-		assert(count % 3 == 0);
-		for(std::size_t i = 0; i < count; i += 3)
+		//triangles facing away from the camera have the winding opposite to facing_order
+		bool is_back_facing_front = (cull_data.facing_order != state.cull_order);
+		bool is_back_facing_culled = (state.cull_side != CullSide::None &&
+									  is_back_facing_front == (state.cull_side == CullSide::Front));
+
+		//surviving meshlets are gathered into one index list, so only their vertices are shaded
+		meshlet_index_data.clear();
+		std::uint64_t culled_meshlets = 0;
+		for(std::size_t i = 0; i < meshlet_count; i++)
 		{
-			auto polygon = vertex_shader_evaluation(vertex_data, index_data, i, shader_data);
-			clipping_evaluation(polygon, {}, fb, state, shader_data);
+			const Meshlet &meshlet = meshlets[i];
+			if(IsMeshletOutsideFrustum(meshlet, cull_data.frustum) ||
+			   (is_back_facing_culled && IsMeshletBackFacing(meshlet, cull_data.camera_position)))
+			{
+				culled_meshlets++;
+				continue;
+			}
+
+			meshlet_index_data.insert(meshlet_index_data.end(),
+									  index_data + meshlet.index_offset,
+									  index_data + meshlet.index_offset + meshlet.triangle_count * 3);
 		}
+
+		CountStatistic(statistics.culled_meshlets, culled_meshlets);
+		if(meshlet_index_data.empty())
+			return;
+
+		DrawIndexed(fb, vertex_data, meshlet_index_data.data(), meshlet_index_data.size(), state, shader_data);
 	}
 
-	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD>
-	Polygon<VO> Pipeline<VO, ATTACHMENT_COUNT, SD>::vertex_shader_evaluation(const std::byte *vertex_data,
-																			 const std::uint32_t *index_data,
-																			 std::size_t index,
-																			 SD &shader_data)
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	DepthTestMode StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::GetDepthTestMode() const noexcept
 	{
-		Polygon<VO> polygon;
-		for(std::uint32_t i = 0; i < 3; i++)
+		return depth_test_mode;
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	const VertexCacheStatistics & StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::GetVertexCacheStatistics() const noexcept
+	{
+		return vertex_cache_statistics;
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::ResetVertexCacheStatistics() noexcept
+	{
+		vertex_cache_statistics = {};
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::BeginOcclusionQuery(OcclusionQuery &query) noexcept
+	{
+		EndOcclusionQuery();
+		occlusion_query = &query;
+		occlusion_query->Begin();
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::EndOcclusionQuery() noexcept
+	{
+		if(!occlusion_query)
+			return;
+
+		occlusion_query->End();
+		occlusion_query = nullptr;
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	const PipelineStatistics & StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::GetStatistics() const noexcept
+	{
+		return statistics;
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::ResetStatistics() noexcept
+	{
+		statistics = {};
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	typename StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::ScreenRect
+	StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::get_draw_rect(const Framebuffer &fb, const State &state) noexcept
+	{
+		const Viewport &viewport = state.viewport;
+		ScreenRect rect{.min_x = viewport.GetX(),
+						.min_y = viewport.GetY(),
+						.max_x = static_cast<std::int64_t>(viewport.GetX()) + viewport.GetWidth() - 1,
+						.max_y = static_cast<std::int64_t>(viewport.GetY()) + viewport.GetHeight() - 1};
+
+		auto clip_by_image = [&](const Image *image) noexcept
 		{
-			std::uint32_t vertex_index = (index_data ? index_data[index + i] : index + i);
-			polygon.vertices[i].vertex = vertex_shader(index + i,
-													   vertex_data + vertex_index * vertex_data_stride,
-													   polygon.vertices[i].attributes,
-													   shader_data);
+			if(!image)
+				return;
+
+			rect.max_x = std::min(rect.max_x, static_cast<std::int64_t>(image->GetWidth()) - 1);
+			rect.max_y = std::min(rect.max_y, static_cast<std::int64_t>(image->GetHeight()) - 1);
+		};
+
+		for(std::size_t i = 0; i < ATTACHMENT_COUNT; i++)
+			clip_by_image(fb.GetColorImage(i));
+
+		clip_by_image(fb.GetDepthImage());
+		if(state.scissor_enable)
+		{
+			rect.min_x = std::max<std::int64_t>(rect.min_x, state.scissor.x);
+			rect.min_y = std::max<std::int64_t>(rect.min_y, state.scissor.y);
+			rect.max_x = std::min(rect.max_x, static_cast<std::int64_t>(state.scissor.x) + state.scissor.width - 1);
+			rect.max_y = std::min(rect.max_y, static_cast<std::int64_t>(state.scissor.y) + state.scissor.height - 1);
 		}
 
-		return polygon;
+		rect.min_x = std::max<std::int64_t>(rect.min_x, 0);
+		rect.min_y = std::max<std::int64_t>(rect.min_y, 0);
+		return rect;
 	}
 
-	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD>
-	void Pipeline<VO, ATTACHMENT_COUNT, SD>::clipping_evaluation(Polygon<VO> polygon,
-																 hrs::flags<ClipPlane> planes,
-																 Framebuffer &fb,
-																 const State &state,
-																 SD &shader_data)
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	typename StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::ScreenRect
+	StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::get_polygon_rect(const Polygon<VO> &polygon) noexcept
 	{
-		for(hrs::flags<ClipPlane> plane = ClipPlane::POSITIVE_W; plane != ClipPlane::MAX_PLANE; plane <<= 1)
+		const auto &v0 = polygon.vertices[0].vertex;
+		const auto &v1 = polygon.vertices[1].vertex;
+		const auto &v2 = polygon.vertices[2].vertex;
+		return ScreenRect{.min_x = static_cast<std::int64_t>(std::floor(std::min({v0[0], v1[0], v2[0]}))),
+						  .min_y = static_cast<std::int64_t>(std::floor(std::min({v0[1], v1[1], v2[1]}))),
+						  .max_x = static_cast<std::int64_t>(std::ceil(std::max({v0[0], v1[0], v2[0]}))),
+						  .max_y = static_cast<std::int64_t>(std::ceil(std::max({v0[1], v1[1], v2[1]})))};
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	hrs::math::glsl::vec2 StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::get_guard_band(const State &state) noexcept
+	{
+		//clip plane at g maps to (g + 1) * half_extent + offset pixels, one pixel is kept
+		//for the sub pixel snapping and the error of the clipped vertices
+		auto narrow = [&](std::uint32_t offset, std::uint32_t extent) noexcept -> float
 		{
-			if(plane & planes)
-				continue;
+			float half_extent = static_cast<float>(extent) / 2;
+			float max_guard_band = (MAX_SCREEN_COORDINATE - 1 - static_cast<float>(offset)) / half_extent - 1;
+			//nothing of a viewport which starts beyond MAX_SCREEN_COORDINATE is drawn
+			return std::clamp(max_guard_band, 0.0f, state.guard_band);
+		};
+
+		const Viewport &viewport = state.viewport;
+		return hrs::math::glsl::vec2(narrow(viewport.GetX(), viewport.GetWidth()),
+									 narrow(viewport.GetY(), viewport.GetHeight()));
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	template<typename P>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::draw(Framebuffer &fb,
+																const DrawInput &input,
+																const State &state,
+																SD &shader_data)
+	{
+		PROFILER_ZONE("Pipeline::Draw");
+		ScreenRect draw_rect = get_draw_rect(fb, state);
+		if(draw_rect.IsEmpty() || input.count < P::VERTEX_COUNT || input.instance_count == 0)
+			return;
+
+		//no fragment passes the depth test
+		if(state.depth_test_enable && state.depth_compare == CompareOp::Never && fb.GetDepthImage())
+			return;
+
+		sample_reach = (fb.GetSampleCount() > 1 ? MAX_SAMPLE_OFFSET : 0);
+		guard_band = get_guard_band(state);
+		depth_test_setup(fb, state);
+		output_merger_setup(fb, state);
+		std::fill(thread_counters.begin(), thread_counters.end(), ThreadCounters{});
+
+		//every instance has its own vertices in the cache, so a batch holds as many instances as fit
+		std::uint32_t batch_size = input.instance_count;
+		if(input.index_data)
+		{
+			std::size_t range = vertex_cache_references_evaluation(input);
+			batch_size = static_cast<std::uint32_t>(std::clamp<std::size_t>(MAX_VERTEX_CACHE_SIZE / range,
+																			 1,
+																			 input.instance_count));
+		}
+
+		for(std::uint32_t first_instance = 0; first_instance < input.instance_count; first_instance += batch_size)
+		{
+			std::uint32_t instance_count = std::min(batch_size, input.instance_count - first_instance);
+			if(input.index_data)
+				vertex_cache_evaluation(input, first_instance, instance_count, shader_data);
+
+			if(thread_pool)
+				draw_binned<P>(fb, input, first_instance, instance_count, draw_rect, state, shader_data);
+			else
+				draw_immediate<P>(fb, input, first_instance, instance_count, draw_rect, state, shader_data);
+		}
+
+		for(const auto &counters : thread_counters)
+		{
+			if(occlusion_query)
+				occlusion_query->AddPassedSamples(counters.passed_samples);
 
-			//clip
-			std::pair<Polygon<VO>, Polygon<VO>> clip_polygons;
-			auto clip_res = polygon.ClipAgainstPlane(plane, clip_polygons);
-			planes |= plane;
-			switch(clip_res)
+			if constexpr(PIPELINE_STATISTICS_ENABLED)
+				statistics += counters.statistics;
+		}
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	template<typename P>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::draw_immediate(Framebuffer &fb,
+																		  const DrawInput &input,
+																		  std::uint32_t first_instance,
+																		  std::uint32_t instance_count,
+																		  const ScreenRect &draw_rect,
+																		  const State &state,
+																		  SD &shader_data)
+	{
+		//geometry and rasterization are interleaved per primitive, so the batch is a single zone
+		PROFILER_ZONE("DrawImmediate");
+		std::size_t count = input.count - input.count % P::VERTEX_COUNT;
+		std::vector<P> &primitives = immediate_chunk.template GetPrimitives<P>();
+		for(std::uint32_t instance_index = first_instance; instance_index < first_instance + instance_count; instance_index++)
+			for(std::size_t i = 0; i < count; i += P::VERTEX_COUNT)
 			{
-				case ClipResult::InsidePlane:
-					break;
-				case ClipResult::OutsidePlane:
-					return;
-					break;
-				case ClipResult::OneResult:
-					clipping_evaluation(clip_polygons.first,
-										planes,
-										fb,
-										state,
-										shader_data);
-					return;
-					break;
-				case ClipResult::TwoResult:
-					clipping_evaluation(clip_polygons.first,
-										planes,
-										fb,
-										state,
-										shader_data);
-					clipping_evaluation(clip_polygons.second,
-										planes,
-										fb,
-										state,
-										shader_data);
-					return;
-					break;
+				primitives.clear();
+				primitive_evaluation(input, i, instance_index, state, shader_data, primitives, thread_counters[0]);
+				for(const auto &primitive : primitives)
+					rasterization(primitive, fb, state, draw_rect, shader_data, thread_counters[0]);
 			}
 
-		}
+		//depth bounds were only widened by the writes, they are tightened once per batch
+		fb.UpdateDirtyDepthBounds(draw_rect.min_x, draw_rect.min_y, draw_rect.max_x, draw_rect.max_y);
+	}
 
-		homogenous_division(polygon);
-		viewport_transform(polygon, state.viewport);
-		if(culling_evaluation(state.cull_side, state.cull_order, polygon))
-			return;
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	template<typename P>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::draw_binned(Framebuffer &fb,
+																	   const DrawInput &input,
+																	   std::uint32_t first_instance,
+																	   std::uint32_t instance_count,
+																	   const ScreenRect &draw_rect,
+																	   const State &state,
+																	   SD &shader_data)
+	{
+		//primitives of all instances of the batch are binned as one range in instance order
+		std::size_t instance_primitive_count = input.count / P::VERTEX_COUNT;
+		std::size_t primitive_count = instance_primitive_count * instance_count;
+
+		std::int64_t first_tile_x = draw_rect.min_x / TILE_SIZE;
+		std::int64_t first_tile_y = draw_rect.min_y / TILE_SIZE;
+		std::int64_t tiles_x = draw_rect.max_x / TILE_SIZE - first_tile_x + 1;
+		std::int64_t tiles_y = draw_rect.max_y / TILE_SIZE - first_tile_y + 1;
+		std::size_t tile_count = tiles_x * tiles_y;
+
+		std::size_t chunk_count = std::min(thread_pool->GetThreadCount(),
+										   (primitive_count + MIN_GEOMETRY_CHUNK_SIZE - 1) / MIN_GEOMETRY_CHUNK_SIZE);
+		if(geometry_chunks.size() < chunk_count)
+			geometry_chunks.resize(chunk_count);
+
+		//geometry stage: every chunk owns a contiguous range of primitives,
+		//so walking chunks in order keeps the submission order inside each tile
+		thread_pool->Dispatch(chunk_count, [&](std::size_t chunk_index, std::size_t thread_index)
+		{
+			//vertex shading of non indexed draws, clipping, primitive setup and binning
+			PROFILER_ZONE("Clipping");
+			GeometryChunk &chunk = geometry_chunks[chunk_index];
+			std::vector<P> &primitives = chunk.template GetPrimitives<P>();
+			primitives.clear();
+			chunk.tile_bins.resize(tile_count);
+			for(auto &bin : chunk.tile_bins)
+				bin.clear();
+
+			std::size_t first_primitive = primitive_count * chunk_index / chunk_count;
+			std::size_t last_primitive = primitive_count * (chunk_index + 1) / chunk_count;
+			for(std::size_t i = first_primitive; i < last_primitive; i++)
+			{
+				std::size_t first_primitive_index = primitives.size();
+				primitive_evaluation(input,
+									 i % instance_primitive_count * P::VERTEX_COUNT,
+									 first_instance + static_cast<std::uint32_t>(i / instance_primitive_count),
+									 state,
+									 shader_data,
+									 primitives,
+									 thread_counters[thread_index]);
+				for(std::size_t j = first_primitive_index; j < primitives.size(); j++)
+				{
+					ScreenRect rect = primitives[j].rect;
+					rect.min_x = std::max(rect.min_x, draw_rect.min_x);
+					rect.min_y = std::max(rect.min_y, draw_rect.min_y);
+					rect.max_x = std::min(rect.max_x, draw_rect.max_x);
+					rect.max_y = std::min(rect.max_y, draw_rect.max_y);
+					if(rect.IsEmpty())
+						continue;
+
+					for(std::int64_t ty = rect.min_y / TILE_SIZE; ty <= rect.max_y / TILE_SIZE; ty++)
+						for(std::int64_t tx = rect.min_x / TILE_SIZE; tx <= rect.max_x / TILE_SIZE; tx++)
+							chunk.tile_bins[(ty - first_tile_y) * tiles_x + (tx - first_tile_x)].push_back(j);
+				}
+			}
+		});
 
-		if(state.topology == RasterizationTopology::Line)
-			rasterization_line_brezenham(polygon, fb, state.depth_test_enable, shader_data);
+		//rasterization stage: tiles never overlap, so they are written to the framebuffer without locks
+		thread_pool->Dispatch(tile_count, [&](std::size_t tile_index, std::size_t thread_index)
+		{
+			//fragment shading is evaluated per pixel inside the rasterization, so it is a part of this zone
+			PROFILER_ZONE("Rasterization");
+			std::int64_t tx = first_tile_x + static_cast<std::int64_t>(tile_index) % tiles_x;
+			std::int64_t ty = first_tile_y + static_cast<std::int64_t>(tile_index) / tiles_x;
+			ScreenRect tile_rect{.min_x = std::max(tx * TILE_SIZE, draw_rect.min_x),
+								 .min_y = std::max(ty * TILE_SIZE, draw_rect.min_y),
+								 .max_x = std::min((tx + 1) * TILE_SIZE - 1, draw_rect.max_x),
+								 .max_y = std::min((ty + 1) * TILE_SIZE - 1, draw_rect.max_y)};
+
+			for(std::size_t i = 0; i < chunk_count; i++)
+			{
+				GeometryChunk &chunk = geometry_chunks[i];
+				const std::vector<P> &primitives = chunk.template GetPrimitives<P>();
+				for(auto primitive_index : chunk.tile_bins[tile_index])
+					rasterization(primitives[primitive_index], fb, state, tile_rect, shader_data, thread_counters[thread_index]);
+			}
+
+			//depth bounds of the tile were only widened by the writes, they are tightened once per draw
+			fb.UpdateDirtyDepthBounds(tile_rect.min_x, tile_rect.min_y, tile_rect.max_x, tile_rect.max_y);
+		});
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	std::size_t StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::vertex_cache_references_evaluation(const DrawInput &input)
+	{
+		//vertices of the faces of segments are referenced by the segments too
+		auto for_each_face_index = [&](auto &&function)
+		{
+			if(!input.faces)
+				return;
+
+			for(std::size_t i = 0; i < input.count; i++)
+				for(std::size_t j = 0; j < 3; j++)
+					function(input.face_index_data[static_cast<std::size_t>(input.faces[i]) * 3 + j]);
+		};
+
+		//only the referenced range is cached, every referenced vertex is transformed once per instance
+		auto [min_index, max_index] = std::minmax_element(input.index_data, input.index_data + input.count);
+		std::uint32_t first_index = *min_index;
+		std::uint32_t last_index = *max_index;
+		for_each_face_index([&](std::uint32_t index) noexcept
+		{
+			first_index = std::min(first_index, index);
+			last_index = std::max(last_index, index);
+		});
+
+		vertex_cache_first_index = first_index;
+		vertex_cache_range = static_cast<std::size_t>(last_index - first_index) + 1;
+		vertex_cache_references.assign(vertex_cache_range, 0);
+
+		std::size_t transformed_vertex_count = 0;
+		auto add_reference = [&](std::uint32_t index) noexcept
+		{
+			std::uint8_t &is_referenced = vertex_cache_references[index - vertex_cache_first_index];
+			transformed_vertex_count += !is_referenced;
+			is_referenced = 1;
+		};
+
+		for(std::size_t i = 0; i < input.count; i++)
+			add_reference(input.index_data[i]);
+
+		for_each_face_index(add_reference);
+
+		vertex_cache_statistics.index_count += input.count * input.instance_count;
+		vertex_cache_statistics.transformed_vertex_count += transformed_vertex_count * input.instance_count;
+		return vertex_cache_range;
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::vertex_cache_evaluation(const DrawInput &input,
+																				   std::uint32_t first_instance,
+																				   std::uint32_t instance_count,
+																				   SD &shader_data)
+	{
+		//vertices of the instance first_instance + i start at i * vertex_cache_range
+		vertex_cache_first_instance = first_instance;
+		std::size_t cache_size = vertex_cache_range * instance_count;
+		vertex_cache.resize(cache_size);
+
+		auto transform_vertices = [&](std::size_t first, std::size_t last, ThreadCounters &counters)
+		{
+			PROFILER_ZONE("VertexShading");
+			for(std::size_t i = first; i < last; i++)
+			{
+				std::size_t offset = i % vertex_cache_range;
+				if(!vertex_cache_references[offset])
+					continue;
+
+				vertex_cache[i].vertex = vertex_shader_invocation(input,
+																  vertex_cache_first_index + offset,
+																  first_instance + i / vertex_cache_range,
+																  vertex_cache[i].attributes,
+																  shader_data,
+																  counters);
+			}
+		};
+
+		std::size_t chunk_count = (thread_pool ?
+									   std::min(thread_pool->GetThreadCount(),
+												(cache_size + MIN_VERTEX_CHUNK_SIZE - 1) / MIN_VERTEX_CHUNK_SIZE) :
+									   1);
+
+		if(chunk_count <= 1)
+			transform_vertices(0, cache_size, thread_counters[0]);
 		else
-			rasterization_fill(polygon, fb, state.depth_test_enable, shader_data);
+			thread_pool->Dispatch(chunk_count, [&](std::size_t chunk_index, std::size_t thread_index)
+			{
+				transform_vertices(cache_size * chunk_index / chunk_count,
+								   cache_size * (chunk_index + 1) / chunk_count,
+								   thread_counters[thread_index]);
+			});
 	}
 
-	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD>
-	void Pipeline<VO, ATTACHMENT_COUNT, SD>::homogenous_division(Polygon<VO> &polygon)
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	hrs::math::glsl::vec4 StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::vertex_shader_invocation(const DrawInput &input,
+																									 std::uint32_t vertex_index,
+																									 std::uint32_t instance_index,
+																									 VO &vertex_output,
+																									 SD &shader_data,
+																									 ThreadCounters &counters)
 	{
-		for(int i = 0; i < 3; i++)
+		CountStatistic(counters.statistics.vertex_shader_invocations);
+		const std::byte *instance_input = (input.instance_data ?
+											   input.instance_data + instance_index * input.instance_data_stride :
+											   nullptr);
+
+		return vertex_shader(vertex_index,
+							 instance_index,
+							 input.vertex_data + vertex_index * vertex_data_stride,
+							 instance_input,
+							 vertex_output,
+							 shader_data);
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	const Vertex<VO> & StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::cached_vertex(std::uint32_t vertex_index,
+																					   std::uint32_t instance_index) const noexcept
+	{
+		return vertex_cache[(instance_index - vertex_cache_first_instance) * vertex_cache_range +
+							vertex_index - vertex_cache_first_index];
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	Vertex<VO> StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::vertex_fetch(const DrawInput &input,
+																			  std::size_t index,
+																			  std::uint32_t instance_index,
+																			  SD &shader_data,
+																			  ThreadCounters &counters)
+	{
+		if(input.index_data)
+			return cached_vertex(input.index_data[index], instance_index);
+
+		Vertex<VO> vertex;
+		vertex.vertex = vertex_shader_invocation(input,
+												 static_cast<std::uint32_t>(index),
+												 instance_index,
+												 vertex.attributes,
+												 shader_data,
+												 counters);
+		return vertex;
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::primitive_evaluation(const DrawInput &input,
+																				std::size_t index,
+																				std::uint32_t instance_index,
+																				const State &state,
+																				SD &shader_data,
+																				std::vector<TriangleSetup> &output,
+																				ThreadCounters &counters)
+	{
+		Polygon<VO> polygon;
+		for(std::size_t i = 0; i < 3; i++)
+			polygon.vertices[i] = vertex_fetch(input, index + i, instance_index, shader_data, counters);
+
+		clipping_evaluation(polygon, state, output, counters);
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::primitive_evaluation(const DrawInput &input,
+																				std::size_t index,
+																				std::uint32_t instance_index,
+																				const State &state,
+																				SD &shader_data,
+																				std::vector<LineSetup> &output,
+																				ThreadCounters &counters)
+	{
+		//faces of the segment are at the indices of its vertices
+		if(input.faces &&
+		   !is_face_visible(input, input.faces[index], instance_index, state) &&
+		   !is_face_visible(input, input.faces[index + 1], instance_index, state))
 		{
-			float inv_w = 1.0f / polygon.vertices[i].vertex[3];
-			polygon.vertices[i].vertex[0] *= inv_w;
-			polygon.vertices[i].vertex[1] *= inv_w;
-			polygon.vertices[i].vertex[2] *= inv_w;
-			polygon.vertices[i].vertex[3] = inv_w;
-			polygon.vertices[i].attributes *= inv_w;
+			CountStatistic(counters.statistics.culled_primitives);
+			return;
+		}
+
+		Vertex<VO> start = vertex_fetch(input, index, instance_index, shader_data, counters);
+		Vertex<VO> end = vertex_fetch(input, index + 1, instance_index, shader_data, counters);
+		ClipResult clip_result = (state.clipping_enable ?
+									  ClipLine(start, end, guard_band) :
+									  ClipResult::TriviallyAccepted);
+		CountStatistic(counters.statistics.clipper_input_primitives);
+		CountStatistic(counters.statistics.clip_results[static_cast<std::size_t>(clip_result)]);
+		switch(clip_result)
+		{
+			case ClipResult::TriviallyAccepted:
+			case ClipResult::Clipped:
+				{
+					CountStatistic(counters.statistics.clipper_output_primitives);
+					LineSetup setup;
+					if(line_setup(start, end, state, setup))
+						output.push_back(setup);
+					else
+						CountStatistic(counters.statistics.culled_primitives);
+				}
+				break;
+			case ClipResult::TriviallyRejected:
+			case ClipResult::ClippedOut:
+				break;
 		}
 	}
 
-	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD>
-	void Pipeline<VO, ATTACHMENT_COUNT, SD>::viewport_transform(Polygon<VO> &polygon, const Viewport &viewport)
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::clipping_evaluation(const Polygon<VO> &polygon,
+																			   const State &state,
+																			   std::vector<TriangleSetup> &output,
+																			   ThreadCounters &counters)
+	{
+		TriangleSetup setup;
+		Vertex<VO> clipped_vertices[MAX_CLIP_VERTEX_COUNT];
+		std::size_t clipped_vertex_count;
+		ClipResult clip_result = (state.clipping_enable ?
+									  polygon.Clip(guard_band, clipped_vertices, clipped_vertex_count) :
+									  ClipResult::TriviallyAccepted);
+		CountStatistic(counters.statistics.clipper_input_primitives);
+		CountStatistic(counters.statistics.clip_results[static_cast<std::size_t>(clip_result)]);
+		switch(clip_result)
+		{
+			case ClipResult::TriviallyAccepted:
+				{
+					Polygon<VO> out_polygon = polygon;
+					for(auto &vert : out_polygon.vertices)
+					{
+						homogenous_division(vert);
+						if(state.clipping_enable)
+							guard_band_clamp(vert);
+
+						viewport_transform(vert, state.viewport);
+					}
+
+					CountStatistic(counters.statistics.clipper_output_primitives);
+					if(triangle_setup(out_polygon, state, setup))
+						output.push_back(setup);
+					else
+						CountStatistic(counters.statistics.culled_primitives);
+				}
+				break;
+			case ClipResult::Clipped:
+				{
+					//every vertex is projected once and the convex result is emitted as a fan
+					for(std::size_t i = 0; i < clipped_vertex_count; i++)
+					{
+						homogenous_division(clipped_vertices[i]);
+						guard_band_clamp(clipped_vertices[i]);
+						viewport_transform(clipped_vertices[i], state.viewport);
+					}
+
+					for(std::size_t i = 1; i + 1 < clipped_vertex_count; i++)
+					{
+						Polygon<VO> out_polygon(clipped_vertices[0], clipped_vertices[i], clipped_vertices[i + 1]);
+						CountStatistic(counters.statistics.clipper_output_primitives);
+						if(triangle_setup(out_polygon, state, setup))
+							output.push_back(setup);
+						else
+							CountStatistic(counters.statistics.culled_primitives);
+					}
+				}
+				break;
+			case ClipResult::TriviallyRejected:
+			case ClipResult::ClippedOut:
+				break;
+		}
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::homogenous_division(Vertex<VO> &vertex)
+	{
+		float inv_w = 1.0f / vertex.vertex[3];
+		vertex.vertex[0] *= inv_w;
+		vertex.vertex[1] *= inv_w;
+		vertex.vertex[2] *= inv_w;
+		vertex.vertex[3] = inv_w;
+		vertex.attributes *= inv_w;
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::guard_band_clamp(Vertex<VO> &vertex) const noexcept
+	{
+		//NaN is kept and rejected by the setup
+		vertex.vertex[0] = std::clamp(vertex.vertex[0], -guard_band[0], guard_band[0]);
+		vertex.vertex[1] = std::clamp(vertex.vertex[1], -guard_band[1], guard_band[1]);
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::viewport_transform(Vertex<VO> &vertex, const Viewport &viewport)
 	{
 #warning ASSUME THAT Z-COMPONENT IS ALREADY IN [0, 1] RANGE!!!
 		float half_width = static_cast<float>(viewport.GetWidth()) / 2;
 		float half_height = static_cast<float>(viewport.GetHeight()) / 2;
 		float depth_delta = viewport.GetMaxDepth() - viewport.GetMinDepth();
 
-		for(auto &vert : polygon.vertices)
-		{
-			vert.vertex[0] = (vert.vertex[0] + 1) * half_width + viewport.GetX();
-			vert.vertex[1] = (vert.vertex[1] - 1) * -half_height + viewport.GetY();
-			vert.vertex[2] = depth_delta * vert.vertex[2] + viewport.GetMinDepth();
-		}
+		//x and y are snapped to the sub pixel grid, so rasterization works on exact fixed point values
+		vertex.vertex[0] = std::round(((vertex.vertex[0] + 1) * half_width + viewport.GetX()) * SUB_PIXEL_SCALE) / SUB_PIXEL_SCALE;
+		vertex.vertex[1] = std::round(((vertex.vertex[1] - 1) * -half_height + viewport.GetY()) * SUB_PIXEL_SCALE) / SUB_PIXEL_SCALE;
+		vertex.vertex[2] = depth_delta * vertex.vertex[2] + viewport.GetMinDepth();
 	}
 
-	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD>
-	bool Pipeline<VO, ATTACHMENT_COUNT, SD>::culling_evaluation(CullSide cull_side,
-																CullOrder cull_order,
-																const Polygon<VO> &polygon) noexcept
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	std::int64_t StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::get_fixed_point_area(const std::int32_t *fixed_x,
+																						 const std::int32_t *fixed_y) noexcept
 	{
-		/*if(cull_side == CullSide::None)
+		//exact in fixed point, y axis goes down
+		return std::int64_t{fixed_x[2] - fixed_x[0]} * (fixed_y[1] - fixed_y[0]) -
+			   std::int64_t{fixed_y[2] - fixed_y[0]} * (fixed_x[1] - fixed_x[0]);
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	bool StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::is_area_culled(std::int64_t area, const State &state) noexcept
+	{
+		if(state.cull_side == CullSide::None)
 			return false;
 
-		hrs::math::vector<std::int64_t, 2> v10(polygon.vertices[1].vertex[0] - polygon.vertices[0].vertex[0],
-											   polygon.vertices[1].vertex[1] - polygon.vertices[0].vertex[1]);
+		bool is_clockwise = area < 0;
+		bool is_front = (state.cull_order == CullOrder::ClockWise ? is_clockwise : !is_clockwise);
+		return is_front == (state.cull_side == CullSide::Front);
+	}
 
-		hrs::math::vector<std::int64_t, 2> v20(polygon.vertices[2].vertex[0] - polygon.vertices[0].vertex[0],
-											   polygon.vertices[2].vertex[1] - polygon.vertices[0].vertex[1]);
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	bool StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::triangle_setup(const Polygon<VO> &polygon,
+																		  const State &state,
+																		  TriangleSetup &setup) noexcept
+	{
+		setup.polygon = polygon;
+		std::int32_t *fixed_x = setup.x;
+		std::int32_t *fixed_y = setup.y;
+		for(int i = 0; i < 3; i++)
+		{
+			//safety net: clipped vertices are inside of the guard band, so only NaN and vertices
+			//of draws without clipping are rejected here
+			const auto &vert = polygon.vertices[i].vertex;
+			bool is_inside = std::abs(vert[0]) < MAX_SCREEN_COORDINATE && std::abs(vert[1]) < MAX_SCREEN_COORDINATE;
+			assert(is_inside || !state.clipping_enable || std::isnan(vert[0]) || std::isnan(vert[1]));
+			if(!is_inside)
+				return false;
+
+			//exact: coordinates are already snapped by the viewport transform
+			fixed_x[i] = static_cast<std::int32_t>(vert[0] * SUB_PIXEL_SCALE);
+			fixed_y[i] = static_cast<std::int32_t>(vert[1] * SUB_PIXEL_SCALE);
+		}
 
-		float screen_z = v20[0] * v10[1] - v20[1] * v10[0];
+		//zero area means degenerate triangle
+		std::int64_t area = get_fixed_point_area(fixed_x, fixed_y);
+		if(area == 0 || is_area_culled(area, state))
+			return false;
 
-		if(cull_side == CullSide::Back)
+		if(area < 0)
 		{
-			if(cull_order == CullOrder::ClockWise)
-				return screen_z >= 0;
-			else
-				return screen_z <= 0;
+			std::swap(setup.polygon.vertices[1], setup.polygon.vertices[2]);
+			std::swap(fixed_x[1], fixed_x[2]);
+			std::swap(fixed_y[1], fixed_y[2]);
+			area = -area;
 		}
-		else
+
+		setup.area = area;
+		if(state.topology == RasterizationTopology::Line)
 		{
-			if(cull_order == CullOrder::ClockWise)
-				return screen_z <= 0;
-			else
-				return screen_z >= 0;
-		}*/
+			setup.rect = get_polygon_rect(setup.polygon);
+			return true;
+		}
+
+		//pixel centers are at k + 0.5, triangle that does not contain any sample of them in its
+		//bounding box covers no sample and is dropped here
+		constexpr std::int32_t half_pixel = SUB_PIXEL_SCALE / 2;
+		auto first_center = [](std::int32_t fixed) noexcept -> std::int64_t
+		{
+			//ceil((fixed - half_pixel) / SUB_PIXEL_SCALE)
+			return -((half_pixel - fixed) >> SUB_PIXEL_BITS);
+		};
+
+		auto last_center = [](std::int32_t fixed) noexcept -> std::int64_t
+		{
+			//floor((fixed - half_pixel) / SUB_PIXEL_SCALE)
+			return (fixed - half_pixel) >> SUB_PIXEL_BITS;
+		};
+
+		setup.rect = ScreenRect{.min_x = first_center(std::min({fixed_x[0], fixed_x[1], fixed_x[2]}) - sample_reach),
+								.min_y = first_center(std::min({fixed_y[0], fixed_y[1], fixed_y[2]}) - sample_reach),
+								.max_x = last_center(std::max({fixed_x[0], fixed_x[1], fixed_x[2]}) + sample_reach),
+								.max_y = last_center(std::max({fixed_y[0], fixed_y[1], fixed_y[2]}) + sample_reach)};
+
+		return !setup.rect.IsEmpty();
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	bool StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::is_face_visible(const DrawInput &input,
+																		   std::uint32_t face,
+																		   std::uint32_t instance_index,
+																		   const State &state) noexcept
+	{
+		const std::uint32_t *face_indices = input.face_index_data + static_cast<std::size_t>(face) * 3;
+		Polygon<VO> polygon(cached_vertex(face_indices[0], instance_index),
+							cached_vertex(face_indices[1], instance_index),
+							cached_vertex(face_indices[2], instance_index));
+
+		//face goes through the same clipping and projection as in clipping_evaluation
+		Vertex<VO> clipped_vertices[MAX_CLIP_VERTEX_COUNT];
+		std::size_t clipped_vertex_count = 3;
+		ClipResult clip_result = (state.clipping_enable ?
+									  polygon.Clip(guard_band, clipped_vertices, clipped_vertex_count) :
+									  ClipResult::TriviallyAccepted);
+		switch(clip_result)
+		{
+			case ClipResult::TriviallyAccepted:
+				std::copy(std::begin(polygon.vertices), std::end(polygon.vertices), clipped_vertices);
+				clipped_vertex_count = 3;
+				break;
+			case ClipResult::Clipped:
+				break;
+			case ClipResult::TriviallyRejected:
+			case ClipResult::ClippedOut:
+				return false;
+				break;
+		}
+
+		std::int32_t fixed_x[MAX_CLIP_VERTEX_COUNT];
+		std::int32_t fixed_y[MAX_CLIP_VERTEX_COUNT];
+		bool is_inside[MAX_CLIP_VERTEX_COUNT];
+		for(std::size_t i = 0; i < clipped_vertex_count; i++)
+		{
+			Vertex<VO> &vert = clipped_vertices[i];
+			homogenous_division(vert);
+			if(state.clipping_enable)
+				guard_band_clamp(vert);
+
+			viewport_transform(vert, state.viewport);
+			is_inside[i] = std::abs(vert.vertex[0]) < MAX_SCREEN_COORDINATE && std::abs(vert.vertex[1]) < MAX_SCREEN_COORDINATE;
+			if(is_inside[i])
+			{
+				fixed_x[i] = static_cast<std::int32_t>(vert.vertex[0] * SUB_PIXEL_SCALE);
+				fixed_y[i] = static_cast<std::int32_t>(vert.vertex[1] * SUB_PIXEL_SCALE);
+			}
+		}
+
+		for(std::size_t i = 1; i + 1 < clipped_vertex_count; i++)
+		{
+			if(!is_inside[0] || !is_inside[i] || !is_inside[i + 1])
+				continue;
+
+			std::int32_t triangle_x[3] = {fixed_x[0], fixed_x[i], fixed_x[i + 1]};
+			std::int32_t triangle_y[3] = {fixed_y[0], fixed_y[i], fixed_y[i + 1]};
+			std::int64_t area = get_fixed_point_area(triangle_x, triangle_y);
+			if(area != 0 && !is_area_culled(area, state))
+				return true;
+		}
 
 		return false;
 	}
 
-	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD>
-	bool Pipeline<VO, ATTACHMENT_COUNT, SD>::is_depth_test_passed(const Image *depth_image,
-																  const hrs::math::vector<std::int64_t, 2> &position,
-																  float test_z) const noexcept
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	bool StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::line_setup(const Vertex<VO> &start,
+																	  const Vertex<VO> &end,
+																	  const State &state,
+																	  LineSetup &setup) noexcept
 	{
-		float ref_z = depth_image->GetValueDepth(position[0], position[1]);
-		if(std::isnan(ref_z) || ref_z < test_z)
-			return false;
+		setup.vertices[0] = start;
+		setup.vertices[1] = end;
+		for(int i = 0; i < 2; i++)
+		{
+			homogenous_division(setup.vertices[i]);
+			if(state.clipping_enable)
+				guard_band_clamp(setup.vertices[i]);
+
+			viewport_transform(setup.vertices[i], state.viewport);
+
+			//safety net, same as in the triangle setup
+			const auto &vert = setup.vertices[i].vertex;
+			bool is_inside = std::abs(vert[0]) < MAX_SCREEN_COORDINATE && std::abs(vert[1]) < MAX_SCREEN_COORDINATE;
+			assert(is_inside || !state.clipping_enable || std::isnan(vert[0]) || std::isnan(vert[1]));
+			if(!is_inside)
+				return false;
+
+			setup.x[i] = static_cast<std::int32_t>(vert[0] * SUB_PIXEL_SCALE);
+			setup.y[i] = static_cast<std::int32_t>(vert[1] * SUB_PIXEL_SCALE);
+		}
+
+		setup.rect = ScreenRect{.min_x = std::min(setup.x[0], setup.x[1]) >> SUB_PIXEL_BITS,
+								.min_y = std::min(setup.y[0], setup.y[1]) >> SUB_PIXEL_BITS,
+								.max_x = std::max(setup.x[0], setup.x[1]) >> SUB_PIXEL_BITS,
+								.max_y = std::max(setup.y[0], setup.y[1]) >> SUB_PIXEL_BITS};
 
 		return true;
 	}
 
-	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD>
-	void Pipeline<VO, ATTACHMENT_COUNT, SD>::rasterization_line_brezenham(const Polygon<VO> &polygon,
-																		  Framebuffer &fb,
-																		  bool depth_test_enable,
-																		  SD &shader_data)
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	bool StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::is_depth_test_passed(const Image *depth_image,
+																				const hrs::math::vector<std::int64_t, 2> &position,
+																				std::uint32_t sample,
+																				float test_z) const noexcept
+	{
+		std::int64_t texel = position[1] * static_cast<std::int64_t>(depth_image->GetWidth()) + position[0];
+		std::int64_t index = texel * static_cast<std::int64_t>(depth_image->GetSampleCount()) + sample;
+		return depth_test_function(depth_image->GetMappedPtr() + index * GetFormatTexelSize(depth_format), test_z);
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::rasterization(const TriangleSetup &setup,
+																		 Framebuffer &fb,
+																		 const State &state,
+																		 const ScreenRect &rect,
+																		 SD &shader_data,
+																		 ThreadCounters &counters)
 	{
-		//sort vertices!!!
+		if(state.topology == RasterizationTopology::Fill)
+		{
+			rasterization_fill(setup, fb, rect, state.depth_test_enable, shader_data, counters);
+			return;
+		}
+
+		//pixel of a vertex is the floor of its fixed point coordinates.
+		//End pixels of segments are not written, so the closed outline writes every vertex once
 		constexpr std::pair<int, int> lines[] = {{0, 1}, {1, 2}, {2, 0}};
 		for(const auto &line : lines)
 		{
-			hrs::math::vector<std::int64_t, 2> start(polygon.vertices[line.first].vertex);
-			float start_z = polygon.vertices[line.first].vertex[2];
-			float start_w = polygon.vertices[line.first].vertex[3];
-			VO start_attributes = polygon.vertices[line.first].attributes;
-
-			hrs::math::vector<std::int64_t, 2> end(polygon.vertices[line.second].vertex);
-			float end_z = polygon.vertices[line.second].vertex[2];
-			float end_w = polygon.vertices[line.second].vertex[3];
-			VO end_attributes = polygon.vertices[line.second].attributes;
-
-			std::int64_t dx = end[0] - start[0];
-			std::int64_t dy = end[1] - start[1];
-			std::int64_t xs = 0, ys = 0;
-			std::int64_t hd;
-			if(dx < 0) {xs = -1; dx = -dx;}
-			else xs = 1;
-			if(dy < 0) {ys = -1; dy = - dy;}
-			else ys = 1;
-
-			std::int64_t major_axis = (dx > dy ? dx : dy);
-			std::int64_t minor_axis = (dx > dy ? dy : dx);
-			std::int64_t tmp_minor_axis = minor_axis;
-			int major_index = (dx > dy ? 0 : 1);
-			int minor_index = (dx > dy ? 1 : 0);
-			std::int64_t major_step = (dx > dy ? xs : ys);
-			std::int64_t minor_step = (dx > dy ? ys : xs);
-
-			float step_z;
-			float step_w;
-			VO step_attributes;
-			FragmentOutput<ATTACHMENT_COUNT> fragment_output;
-
-			Image *depth_image = fb.GetDepthImage();
-
-			step_z = (end_z - start_z) / major_axis;
-			step_w = (end_w - start_w) / major_axis;
-			step_attributes = (end_attributes - start_attributes) / major_axis;
-
-			auto mul = []<typename T>(const T &value, const T &step, std::size_t i)
+			const std::int64_t start[2] = {setup.x[line.first] >> SUB_PIXEL_BITS, setup.y[line.first] >> SUB_PIXEL_BITS};
+			const std::int64_t end[2] = {setup.x[line.second] >> SUB_PIXEL_BITS, setup.y[line.second] >> SUB_PIXEL_BITS};
+			rasterization_line_brezenham(setup.polygon.vertices[line.first],
+										 setup.polygon.vertices[line.second],
+										 start,
+										 end,
+										 fb,
+										 rect,
+										 state.depth_test_enable,
+										 shader_data,
+										 counters);
+		}
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::rasterization(const LineSetup &setup,
+																		 Framebuffer &fb,
+																		 const State &state,
+																		 const ScreenRect &rect,
+																		 SD &shader_data,
+																		 ThreadCounters &counters)
+	{
+		const std::int64_t start[2] = {setup.x[0] >> SUB_PIXEL_BITS, setup.y[0] >> SUB_PIXEL_BITS};
+		const std::int64_t end[2] = {setup.x[1] >> SUB_PIXEL_BITS, setup.y[1] >> SUB_PIXEL_BITS};
+		rasterization_line_brezenham(setup.vertices[0],
+									 setup.vertices[1],
+									 start,
+									 end,
+									 fb,
+									 rect,
+									 state.depth_test_enable,
+									 shader_data,
+									 counters);
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::rasterization_line_brezenham(const Vertex<VO> &start_vertex,
+																						const Vertex<VO> &end_vertex,
+																						const std::int64_t (&start)[2],
+																						const std::int64_t (&end)[2],
+																						Framebuffer &fb,
+																						const ScreenRect &rect,
+																						bool depth_test_enable,
+																						SD &shader_data,
+																						ThreadCounters &counters)
+	{
+		Image *depth_image = fb.GetDepthImage();
+		bool use_depth_test = depth_test_enable && depth_image && depth_compare != CompareOp::Always;
+		const std::byte *early_depth_data = (use_depth_test && depth_test_mode != DepthTestMode::Late ?
+											 depth_image->GetMappedPtr() :
+											 nullptr);
+		std::size_t depth_texel_size = GetFormatTexelSize(depth_format);
+		const Image *late_depth_image = (use_depth_test && depth_test_mode == DepthTestMode::Late ? depth_image : nullptr);
+		std::int64_t depth_width = (depth_image ? depth_image->GetWidth() : 0);
+		//lines cover whole pixels: every sample gets the depth of the pixel center
+		std::size_t sample_count = fb.GetSampleCount();
+		std::uint32_t full_sample_mask = (1u << sample_count) - 1;
+
+		//ceil(a / b) for b > 0
+		auto ceil_div = [](std::int64_t a, std::int64_t b) noexcept
+		{
+			return (a >= 0 ? (a + b - 1) / b : -(-a / b));
+		};
+
+		const std::int64_t rect_min[2] = {rect.min_x, rect.min_y};
+		const std::int64_t rect_max[2] = {rect.max_x, rect.max_y};
+
+		//pixels are visited from start(inclusive) to end(exclusive) along the major axis
+		int major_index = (std::abs(end[0] - start[0]) >= std::abs(end[1] - start[1]) ? 0 : 1);
+		int minor_index = 1 - major_index;
+		std::int64_t major_length = std::abs(end[major_index] - start[major_index]);
+		std::int64_t minor_length = std::abs(end[minor_index] - start[minor_index]);
+		std::int64_t major_step = (end[major_index] < start[major_index] ? -1 : 1);
+		std::int64_t minor_step = (end[minor_index] < start[minor_index] ? -1 : 1);
+		if(major_length == 0)
+			return;
+
+		//range of steps from the start which keep the coordinate inside of the rect
+		auto get_step_range = [&](int index, std::int64_t step) noexcept
+		{
+			return (step > 0 ?
+					std::pair{rect_min[index] - start[index], rect_max[index] - start[index]} :
+					std::pair{start[index] - rect_max[index], start[index] - rect_min[index]});
+		};
+
+		//pixel i is k(i) = floor((2 * minor_length * i + major_length) / (2 * major_length)) steps away
+		//along the minor axis. Both coordinates are monotonic in i, so the segment is clipped
+		//by the rect analytically(Liang-Barsky in the step parameter) before any pixel is visited
+		auto [first, last] = get_step_range(major_index, major_step);
+		first = std::max<std::int64_t>(first, 0);
+		last = std::min(last, major_length - 1);
+
+		auto [first_k, last_k] = get_step_range(minor_index, minor_step);
+		if(minor_length == 0)
+		{
+			if(first_k > 0 || last_k < 0)
+				return;
+		}
+		else
+		{
+			first = std::max(first, ceil_div(2 * major_length * first_k - major_length, 2 * minor_length));
+			last = std::min(last, ceil_div(2 * major_length * last_k + major_length, 2 * minor_length) - 1);
+		}
+
+		if(first > last)
+			return;
+
+		std::int64_t k = (2 * minor_length * first + major_length) / (2 * major_length);
+		std::int64_t error = 2 * minor_length * first + major_length - 2 * major_length * k;
+		hrs::math::vector<std::int64_t, 2> position;
+		position[major_index] = start[major_index] + major_step * first;
+		position[minor_index] = start[minor_index] + minor_step * k;
+
+		std::int64_t texel_steps[2] = {1, depth_width};
+		std::int64_t major_texel_step = major_step * texel_steps[major_index];
+		std::int64_t minor_texel_step = minor_step * texel_steps[minor_index];
+		std::int64_t texel = position[1] * depth_width + position[0];
+
+		//z, 1/w and attributes/w are affine along the line. Attributes are stepped incrementally,
+		//z and 1/w are evaluated from the start of the line, so visibility of a pixel
+		//does not depend on the rect which clipped the line(viewport or tile)
+		float inv_length = 1.0f / static_cast<float>(major_length);
+		float step_z = (end_vertex.vertex[2] - start_vertex.vertex[2]) * inv_length;
+		float step_w = (end_vertex.vertex[3] - start_vertex.vertex[3]) * inv_length;
+		VO step_attributes = (end_vertex.attributes - start_vertex.attributes) * inv_length;
+		VO attributes = start_vertex.attributes + step_attributes * static_cast<float>(first);
+
+		FragmentOutput<ATTACHMENT_COUNT> fragment_output;
+		const FragmentDerivatives<VO> derivatives{};//lines have no screen space plane
+		float sample_depth[MAX_SAMPLE_COUNT];
+		for(std::int64_t i = first; i <= last; i++)
+		{
+			float z = start_vertex.vertex[2] + step_z * static_cast<float>(i);
+			float w = start_vertex.vertex[3] + step_w * static_cast<float>(i);
+			std::uint32_t sample_mask = full_sample_mask;
+			for(std::size_t sample = 0; sample < sample_count; sample++)
 			{
-				return value + step * i;
-			};
+				sample_depth[sample] = z;
+				if(early_depth_data && !depth_test_function(early_depth_data + (texel * sample_count + sample) * depth_texel_size, z))
+					sample_mask &= ~(1u << sample);
+			}
+
+			CountStatistic(counters.statistics.depth_rejected_fragments, !sample_mask);
+			if(sample_mask &&
+			   fragment_evaluation(late_depth_image,
+								   position,
+								   sample_mask,
+								   sample_depth,
+								   attributes * (1.0f / w),
+								   derivatives,
+								   z,
+								   fragment_output,
+								   shader_data,
+								   counters))
+			{
+				fb.ExpandDepthBounds(position[0], position[1], fragment_output.depth);
+			}
 
-			std::size_t i = 0;
-			while(start[major_index] != end[major_index])
+			position[major_index] += major_step;
+			texel += major_texel_step;
+			attributes += step_attributes;
+			error += 2 * minor_length;
+			if(error >= 2 * major_length)
 			{
-				float true_z = 1.0f / mul(start_w, step_w, i);
-				if(depth_test_enable && depth_image && is_depth_test_passed(depth_image, start, mul(start_z, step_z, i)))
+				error -= 2 * major_length;
+				position[minor_index] += minor_step;
+				texel += minor_texel_step;
+			}
+		}
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::rasterization_fill(const TriangleSetup &setup,
+																			  Framebuffer &fb,
+																			  const ScreenRect &rect,
+																			  bool depth_test_enable,
+																			  SD &shader_data,
+																			  ThreadCounters &counters)
+	{
+		//vertices are already in screen space: [0], [1] - window coordinates, [2] - depth,
+		//[3] - 1/w and attributes are premultiplied by 1/w in homogenous_division.
+		//Triangle setup has already culled it and made the winding positive, so every
+		//edge function is non negative inside the triangle
+		const Vertex<VO> *v0 = &setup.polygon.vertices[0];
+		const Vertex<VO> *v1 = &setup.polygon.vertices[1];
+		const Vertex<VO> *v2 = &setup.polygon.vertices[2];
+
+		//edge functions are exact in fixed point: E = a * x + b * y + c for sub pixel x and y.
+		//Edge i is opposite to vertex i, so E_i / area is the barycentric coordinate of vertex i
+		constexpr int edges[3][2] = {{1, 2}, {2, 0}, {0, 1}};
+		std::int64_t edge_a[3];
+		std::int64_t edge_b[3];
+		std::int64_t edge_c[3];
+		std::int64_t edge_bias[3];
+		float edge_dx[3];
+		float edge_dy[3];
+
+		//top-left fill rule: pixel centers lying exactly on an edge belong to the triangle
+		//only if the edge is a top edge or a left edge
+		RasterSpan span;
+		for(int i = 0; i < 3; i++)
+		{
+			std::int64_t ax = setup.x[edges[i][0]];
+			std::int64_t ay = setup.y[edges[i][0]];
+			std::int64_t dx = setup.x[edges[i][1]] - ax;
+			std::int64_t dy = setup.y[edges[i][1]] - ay;
+			edge_a[i] = dy;
+			edge_b[i] = -dx;
+			edge_c[i] = dx * ay - dy * ax;
+			edge_bias[i] = ((dy == 0 && dx < 0) || dy > 0 ? 0 : 1);
+			span.edge_dx[i] = static_cast<std::int32_t>(dy);
+			edge_dx[i] = static_cast<float>(dy) / SUB_PIXEL_SCALE;
+			edge_dy[i] = static_cast<float>(-dx) / SUB_PIXEL_SCALE;
+		}
+
+		//value of the edge function at the center of the pixel
+		auto edge_function = [&](int i, std::int64_t x, std::int64_t y) noexcept
+		{
+			return edge_a[i] * (x * SUB_PIXEL_SCALE + SUB_PIXEL_SCALE / 2) +
+				   edge_b[i] * (y * SUB_PIXEL_SCALE + SUB_PIXEL_SCALE / 2) +
+				   edge_c[i];
+		};
+
+		float area = static_cast<float>(setup.area) / (SUB_PIXEL_SCALE * SUB_PIXEL_SCALE);
+
+		std::int64_t min_x = std::max(setup.rect.min_x, rect.min_x);
+		std::int64_t min_y = std::max(setup.rect.min_y, rect.min_y);
+		std::int64_t max_x = std::min(setup.rect.max_x, rect.max_x);
+		std::int64_t max_y = std::min(setup.rect.max_y, rect.max_y);
+
+		Image *depth_image = fb.GetDepthImage();
+		bool use_depth_test = depth_test_enable && depth_image && depth_compare != CompareOp::Always;
+		if(min_x > max_x || min_y > max_y)
+			return;
+
+		std::size_t sample_count = fb.GetSampleCount();
+		std::int64_t block_sample_reach = (sample_count > 1 ? MAX_SAMPLE_OFFSET : 0);
+
+		//hierarchical z: blocks are aligned to the screen origin, so they never cross
+		//tiles of the binned mode and each block is owned by one thread
+		constexpr std::int64_t block_size = Framebuffer::DEPTH_BOUNDS_BLOCK_SIZE;
+		DepthBounds *depth_bounds = (depth_image ? fb.GetDepthBounds() : nullptr);
+		std::size_t depth_bounds_width = fb.GetDepthBoundsWidth();
+		std::int64_t first_block_x = min_x / block_size;
+		std::int64_t first_block_y = min_y / block_size;
+		std::int64_t last_block_x = max_x / block_size;
+		std::int64_t last_block_y = max_y / block_size;
+
+		//z range is quantized like the stored depth, so it is compared with the bounds exactly
+		float min_z = QuantizeFormatDepth(depth_format, std::min({v0->vertex[2], v1->vertex[2], v2->vertex[2]}));
+		float max_z = QuantizeFormatDepth(depth_format, std::max({v0->vertex[2], v1->vertex[2], v2->vertex[2]}));
+		auto is_block_occluded = [&](std::int64_t block_x, std::int64_t block_y) noexcept
+		{
+			const DepthBounds &bounds = depth_bounds[block_y * depth_bounds_width + block_x];
+			return IsDepthRangeRejected(depth_compare, min_z, max_z, bounds.min, bounds.max);
+		};
+
+		//with late depth test fragment depth is known only after shading,
+		//so neither hierarchical rejection nor early per pixel test can be used
+		bool use_early_depth_test = use_depth_test && depth_test_mode != DepthTestMode::Late;
+		const Image *late_depth_image = (use_depth_test && !use_early_depth_test ? depth_image : nullptr);
+
+		//whole triangle is rejected before the attribute setup if it fails the test against every block
+		if(use_early_depth_test && depth_bounds)
+		{
+			bool is_occluded = true;
+			for(std::int64_t by = first_block_y; by <= last_block_y && is_occluded; by++)
+				for(std::int64_t bx = first_block_x; bx <= last_block_x && is_occluded; bx++)
+					is_occluded = is_block_occluded(bx, by);
+
+			if(is_occluded)
+				return;
+		}
+
+		//z, 1/w and attributes/w are affine in screen space, so their gradients are constant
+		//over the triangle and any pixel is reached from the origin with a multiply-add
+		float inv_area = 1.0f / area;
+		auto gradient = [&](float f0, float f1, float f2, const float *coeff) noexcept
+		{
+			return (f0 * coeff[0] + f1 * coeff[1] + f2 * coeff[2]) * inv_area;
+		};
+
+		span.dz_dx = gradient(v0->vertex[2], v1->vertex[2], v2->vertex[2], edge_dx);
+		float dz_dy = gradient(v0->vertex[2], v1->vertex[2], v2->vertex[2], edge_dy);
+		span.dw_dx = gradient(v0->vertex[3], v1->vertex[3], v2->vertex[3], edge_dx);
+		float dw_dy = gradient(v0->vertex[3], v1->vertex[3], v2->vertex[3], edge_dy);
+		VO dattr_dx = (v0->attributes * edge_dx[0] + v1->attributes * edge_dx[1] + v2->attributes * edge_dx[2]) * inv_area;
+		VO dattr_dy = (v0->attributes * edge_dy[0] + v1->attributes * edge_dy[1] + v2->attributes * edge_dy[2]) * inv_area;
+
+		//values at the center of the first pixel of the bounding box
+		float origin_l0 = static_cast<float>(edge_function(0, min_x, min_y)) / static_cast<float>(setup.area);
+		float origin_l1 = static_cast<float>(edge_function(1, min_x, min_y)) / static_cast<float>(setup.area);
+		float origin_l2 = 1.0f - origin_l0 - origin_l1;
+
+		float origin_z = v0->vertex[2] * origin_l0 + v1->vertex[2] * origin_l1 + v2->vertex[2] * origin_l2;
+		float origin_w = v0->vertex[3] * origin_l0 + v1->vertex[3] * origin_l1 + v2->vertex[3] * origin_l2;
+		VO origin_attributes = v0->attributes * origin_l0 + v1->attributes * origin_l1 + v2->attributes * origin_l2;
+
+		const std::byte *depth_data = (use_early_depth_test ? depth_image->GetMappedPtr() : nullptr);
+		std::size_t depth_width = (use_depth_test ? depth_image->GetWidth() : 0);
+		std::size_t depth_texel_size = GetFormatTexelSize(depth_format);
+
+		//derivatives are the same for all pixels of the quad, so they are taken between its perspective
+		//corrected corners. Corners outside of the triangle extrapolate the plane like helper invocations
+		const FragmentDerivatives<VO> no_derivatives{};
+		auto get_quad_derivatives = [&](std::int64_t x, std::int64_t y) noexcept
+		{
+			float qx = static_cast<float>((x & ~std::int64_t(1)) - min_x);
+			float qy = static_cast<float>((y & ~std::int64_t(1)) - min_y);
+			VO attributes = origin_attributes + dattr_dx * qx + dattr_dy * qy;
+			float w = origin_w + span.dw_dx * qx + dw_dy * qy;
+			VO a00 = attributes * (1.0f / w);
+			VO a10 = (attributes + dattr_dx) * (1.0f / (w + span.dw_dx));
+			VO a01 = (attributes + dattr_dy) * (1.0f / (w + dw_dy));
+
+			return FragmentDerivatives<VO>{a10 - a00, a01 - a00};
+		};
+
+		FragmentOutput<ATTACHMENT_COUNT> fragment_output;
+
+		//range of the depths written to the current block. Stored bounds are only widened by it,
+		//blocks are rescanned once the tile(or the immediate draw) is finished
+		bool is_depth_written = false;
+		bool is_written_depth_nan = false;
+		float written_min_depth = INFINITY;
+		float written_max_depth = -INFINITY;
+		auto add_written_depth = [&](const float *depths, std::size_t count) noexcept
+		{
+			//late depth replaces depths of the samples, so the shader output is added as well
+			is_depth_written = true;
+			for(std::size_t i = 0; i <= count; i++)
+			{
+				float depth = (i < count ? depths[i] : fragment_output.depth);
+				is_written_depth_nan |= std::isnan(depth);
+				written_min_depth = std::min(written_min_depth, depth);
+				written_max_depth = std::max(written_max_depth, depth);
+			}
+		};
+
+		hrs::math::vector<std::int64_t, 2> position;
+		alignas(32) float block_z[RASTER_BLOCK_SIZE];
+		alignas(32) float block_w[RASTER_BLOCK_SIZE];
+		alignas(32) float quad_z[2][RASTER_BLOCK_SIZE];
+		alignas(32) float quad_w[2][RASTER_BLOCK_SIZE];
+		alignas(32) std::byte quad_depth[RASTER_BLOCK_SIZE * sizeof(float)];
+		alignas(32) float block_sample_z[MAX_SAMPLE_COUNT][RASTER_BLOCK_SIZE];
+		std::uint32_t block_sample_mask[MAX_SAMPLE_COUNT];
+		float sample_depth[MAX_SAMPLE_COUNT];
+		for(std::int64_t by = first_block_y; by <= last_block_y; by++)
+		{
+			std::int64_t block_min_y = std::max(by * block_size, min_y);
+			std::int64_t block_max_y = std::min(by * block_size + block_size - 1, max_y);
+			for(std::int64_t bx = first_block_x; bx <= last_block_x; bx++)
+			{
+				std::int64_t block_min_x = std::max(bx * block_size, min_x);
+				std::int64_t block_max_x = std::min(bx * block_size + block_size - 1, max_x);
+
+				//block is outside of the triangle if some edge function is negative at all its corners(samples)
+				bool is_outside = false;
+				for(int i = 0; i < 3 && !is_outside; i++)
 				{
-					fragment_shader(mul(start_attributes, step_attributes, i) * true_z, start, mul(start_z, step_z, i), fragment_output, shader_data);
-					set_framebuffer_output(fb, start, fragment_output, start_z);
+					std::int64_t e = edge_function(i, block_min_x, block_min_y) - edge_bias[i];
+					e += std::max<std::int64_t>(edge_a[i], 0) * (block_max_x - block_min_x) * SUB_PIXEL_SCALE +
+						 std::max<std::int64_t>(edge_b[i], 0) * (block_max_y - block_min_y) * SUB_PIXEL_SCALE +
+						 (std::abs(edge_a[i]) + std::abs(edge_b[i])) * block_sample_reach;
+
+					is_outside = e < 0;
 				}
 
-				start[major_index] += major_step;
-				//start_z += step_z;
-				//start_w += step_w;
-				//start_attributes += step_attributes;
-				minor_axis += tmp_minor_axis;
-				if(minor_axis >= major_axis)
+				if(is_outside)
+					continue;
+
+				//trivially visible blocks skip per pixel depth reads
+				const std::byte *block_depth_data = depth_data;
+				if(use_early_depth_test && depth_bounds)
 				{
-					minor_axis -= major_axis;
-					start[minor_index] += minor_step;
+					if(is_block_occluded(bx, by))
+						continue;
+
+					const DepthBounds &bounds = depth_bounds[by * depth_bounds_width + bx];
+					if(IsDepthRangeAccepted(depth_compare, min_z, max_z, bounds.min, bounds.max))
+						block_depth_data = nullptr;
+				}
+
+				is_depth_written = false;
+				is_written_depth_nan = false;
+				written_min_depth = INFINITY;
+				written_max_depth = -INFINITY;
+				if(is_quad_rasterization && sample_count == 1)
+				{
+					//2x2 quads are aligned to even pixels, so a run of RASTER_BLOCK_SIZE lanes of two rows
+					//holds whole quads. Pixels before the block are masked off and belong to the neighbour
+					for(std::int64_t y = block_min_y & ~std::int64_t(1); y <= block_max_y; y += 2)
+					{
+						for(std::int64_t x = block_min_x & ~std::int64_t(1); x <= block_max_x; x += RASTER_BLOCK_SIZE)
+						{
+							std::uint32_t lane_count = static_cast<std::uint32_t>(std::min<std::int64_t>(block_max_x - x + 1,
+																										  RASTER_BLOCK_SIZE));
+							std::uint32_t quad_mask[2] = {0, 0};
+							for(std::int64_t row = 0; row < 2; row++)
+							{
+								std::int64_t ry = y + row;
+								if(ry < block_min_y || ry > block_max_y)
+									continue;
+
+								RasterBlockStart block;
+								for(int i = 0; i < 3; i++)
+								{
+									std::int64_t e = (edge_function(i, x, ry) - edge_bias[i]) >> SUB_PIXEL_BITS;
+									block.e[i] = static_cast<std::int32_t>(std::clamp<std::int64_t>(e, -RASTER_EDGE_CLAMP, RASTER_EDGE_CLAMP));
+								}
+
+								float fx = static_cast<float>(x - min_x);
+								float fy = static_cast<float>(ry - min_y);
+								block.z = origin_z + span.dz_dx * fx + dz_dy * fy;
+								block.w = origin_w + span.dw_dx * fx + dw_dy * fy;
+
+								//pixel before the block is outside of the rect and may belong to the tile of another thread,
+								//so it is never read: its lane gets the depth of the next pixel and is masked off below
+								const std::byte *quad_depth_row = (block_depth_data ?
+																   block_depth_data + (ry * depth_width + x) * depth_texel_size :
+																   nullptr);
+								if(quad_depth_row && x < block_min_x)
+								{
+									std::memcpy(quad_depth + depth_texel_size,
+												quad_depth_row + depth_texel_size,
+												(lane_count - 1) * depth_texel_size);
+									std::memcpy(quad_depth, quad_depth_row + depth_texel_size, depth_texel_size);
+									quad_depth_row = quad_depth;
+								}
+
+								quad_mask[row] = raster_block_kernel(span,
+																	 block,
+																	 quad_depth_row,
+																	 lane_count,
+																	 quad_z[row],
+																	 quad_w[row]);
+								if(x < block_min_x)
+									quad_mask[row] &= ~std::uint32_t(1);
+
+								if constexpr(PIPELINE_STATISTICS_ENABLED)
+									if(block_depth_data)
+										count_depth_rejected_fragments(span,
+																	   block,
+																	   lane_count,
+																	   quad_mask[row] | (x < block_min_x ? 1u : 0u),
+																	   counters);
+							}
+
+							for(std::uint32_t quad = 0; quad < RASTER_BLOCK_SIZE / 2; quad++)
+							{
+								std::uint32_t quad_lanes = 3u << (quad * 2);
+								if(!((quad_mask[0] | quad_mask[1]) & quad_lanes))
+									continue;
+
+								const FragmentDerivatives<VO> derivatives = get_quad_derivatives(x + quad * 2, y);
+								for(std::int64_t row = 0; row < 2; row++)
+								{
+									std::uint32_t mask = quad_mask[row] & quad_lanes;
+									while(mask)
+									{
+										int lane = std::countr_zero(mask);
+										mask &= mask - 1;
+
+										position[0] = x + lane;
+										position[1] = y + row;
+										VO attributes = origin_attributes +
+														dattr_dx * static_cast<float>(position[0] - min_x) +
+														dattr_dy * static_cast<float>(position[1] - min_y);
+										if(fragment_evaluation(late_depth_image,
+															   position,
+															   1,
+															   &quad_z[row][lane],
+															   attributes * (1.0f / quad_w[row][lane]),
+															   derivatives,
+															   quad_z[row][lane],
+															   fragment_output,
+															   shader_data,
+															   counters))
+											add_written_depth(&quad_z[row][lane], 1);
+									}
+								}
+							}
+						}
+					}
+
+					if(is_depth_written && depth_bounds)
+						fb.ExpandBlockDepthBounds(bx,
+												  by,
+												  (is_written_depth_nan ? NAN : written_min_depth),
+												  written_max_depth);
+
+					continue;
+				}
+
+				for(std::int64_t y = block_min_y; y <= block_max_y; y++)
+				{
+					float fy = static_cast<float>(y - min_y);
+					const std::byte *depth_row = (block_depth_data ? block_depth_data + y * depth_width * depth_texel_size : nullptr);
+					position[1] = y;
+					for(std::int64_t x = block_min_x; x <= block_max_x; x += RASTER_BLOCK_SIZE)
+					{
+						float fx = static_cast<float>(x - min_x);
+						RasterBlockStart block;
+						for(int i = 0; i < 3; i++)
+						{
+							std::int64_t e = (edge_function(i, x, y) - edge_bias[i]) >> SUB_PIXEL_BITS;
+							block.e[i] = static_cast<std::int32_t>(std::clamp<std::int64_t>(e, -RASTER_EDGE_CLAMP, RASTER_EDGE_CLAMP));
+						}
+
+						block.z = origin_z + span.dz_dx * fx + dz_dy * fy;
+						block.w = origin_w + span.dw_dx * fx + dw_dy * fy;
+
+						std::uint32_t lane_count = static_cast<std::uint32_t>(std::min<std::int64_t>(block_max_x - x + 1,
+																									  RASTER_BLOCK_SIZE));
+						if(sample_count > 1)
+						{
+							//coverage of every sample is the kernel coverage with the edge functions moved to the sample.
+							//Pixel is shaded once at its center if any of its samples is covered and passes the depth test
+							std::uint32_t pixel_mask = 0;
+							for(std::size_t sample = 0; sample < sample_count; sample++)
+							{
+								std::int64_t ox = SAMPLE_OFFSETS[sample][0];
+								std::int64_t oy = SAMPLE_OFFSETS[sample][1];
+								RasterBlockStart sample_block;
+								for(int i = 0; i < 3; i++)
+								{
+									std::int64_t e = (edge_function(i, x, y) + edge_a[i] * ox + edge_b[i] * oy - edge_bias[i]) >> SUB_PIXEL_BITS;
+									sample_block.e[i] = static_cast<std::int32_t>(std::clamp<std::int64_t>(e, -RASTER_EDGE_CLAMP, RASTER_EDGE_CLAMP));
+								}
+
+								sample_block.z = block.z + (span.dz_dx * ox + dz_dy * oy) / SUB_PIXEL_SCALE;
+								sample_block.w = block.w;
+								block_sample_mask[sample] = raster_block_kernel(span,
+																				sample_block,
+																				nullptr,
+																				lane_count,
+																				block_sample_z[sample],
+																				block_w);
+								pixel_mask |= block_sample_mask[sample];
+							}
+
+							if(!pixel_mask)
+								continue;
+
+							VO block_attributes = origin_attributes + dattr_dx * fx + dattr_dy * fy;
+							while(pixel_mask)
+							{
+								int lane = std::countr_zero(pixel_mask);
+								pixel_mask &= pixel_mask - 1;
+
+								std::size_t texel = (y * depth_width + x + lane) * sample_count;
+								std::uint32_t sample_mask = 0;
+								for(std::size_t sample = 0; sample < sample_count; sample++)
+								{
+									float z = block_sample_z[sample][lane];
+									sample_depth[sample] = z;
+									if(((block_sample_mask[sample] >> lane) & 1) &&
+									   (!block_depth_data || depth_test_function(block_depth_data + (texel + sample) * depth_texel_size, z)))
+										sample_mask |= 1u << sample;
+								}
+
+								if(!sample_mask)
+								{
+									CountStatistic(counters.statistics.depth_rejected_fragments);
+									continue;
+								}
+
+								position[0] = x + lane;
+								float offset = static_cast<float>(lane);
+								VO attributes = block_attributes + dattr_dx * offset;
+								if(fragment_evaluation(late_depth_image,
+													   position,
+													   sample_mask,
+													   sample_depth,
+													   attributes * (1.0f / (block.w + span.dw_dx * offset)),
+													   (is_quad_rasterization ? get_quad_derivatives(x + lane, y) : no_derivatives),
+													   block.z + span.dz_dx * offset,
+													   fragment_output,
+													   shader_data,
+													   counters))
+									add_written_depth(sample_depth, sample_count);
+							}
+
+							continue;
+						}
+
+						std::uint32_t mask = raster_block_kernel(span,
+																 block,
+																 (depth_row ? depth_row + x * depth_texel_size : nullptr),
+																 lane_count,
+																 block_z,
+																 block_w);
+
+						if constexpr(PIPELINE_STATISTICS_ENABLED)
+							if(depth_row)
+								count_depth_rejected_fragments(span, block, lane_count, mask, counters);
+
+						if(!mask)
+							continue;
+
+						VO block_attributes = origin_attributes + dattr_dx * fx + dattr_dy * fy;
+						while(mask)
+						{
+							int lane = std::countr_zero(mask);
+							mask &= mask - 1;
+
+							position[0] = x + lane;
+							VO attributes = block_attributes + dattr_dx * static_cast<float>(lane);
+							if(fragment_evaluation(late_depth_image,
+												   position,
+												   1,
+												   &block_z[lane],
+												   attributes * (1.0f / block_w[lane]),
+												   no_derivatives,
+												   block_z[lane],
+												   fragment_output,
+												   shader_data,
+												   counters))
+								add_written_depth(&block_z[lane], 1);
+						}
+					}
 				}
 
-				i++;
+				if(is_depth_written && depth_bounds)
+					fb.ExpandBlockDepthBounds(bx,
+											  by,
+											  (is_written_depth_nan ? NAN : written_min_depth),
+											  written_max_depth);
 			}
 		}
 	}
 
-	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD>
-	void Pipeline<VO, ATTACHMENT_COUNT, SD>::rasterization_fill(const Polygon<VO> &polygon,
-																Framebuffer &fb,
-																bool depth_test_enable,
-																SD &shader_data)
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::count_depth_rejected_fragments(const RasterSpan &span,
+																						  const RasterBlockStart &block,
+																						  std::uint32_t lane_count,
+																						  std::uint32_t passed_mask,
+																						  ThreadCounters &counters) const noexcept
+	{
+		//coverage is evaluated again without the depth test
+		alignas(32) float z[RASTER_BLOCK_SIZE];
+		alignas(32) float w[RASTER_BLOCK_SIZE];
+		std::uint32_t covered_mask = raster_block_kernel(span, block, nullptr, lane_count, z, w);
+		CountStatistic(counters.statistics.depth_rejected_fragments, std::popcount(covered_mask & ~passed_mask));
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	bool StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::fragment_evaluation(const Image *late_depth_image,
+																			   const hrs::math::vector<std::int64_t, 2> &position,
+																			   std::uint32_t sample_mask,
+																			   const float *sample_depth,
+																			   const VO &attributes,
+																			   const FragmentDerivatives<VO> &derivatives,
+																			   float depth,
+																			   FragmentOutput<ATTACHMENT_COUNT> &fragment_output,
+																			   SD &shader_data,
+																			   ThreadCounters &counters)
 	{
+		fragment_output.depth = depth;
+		fragment_output.discard = false;
+		CountStatistic(counters.statistics.fragment_shader_invocations);
+		fragment_shader(attributes, derivatives, position, depth, fragment_output, shader_data);
 
+		if(depth_test_mode == DepthTestMode::Early)
+		{
+			fragment_output.depth = depth;
+			return set_framebuffer_output(position, sample_mask, fragment_output, sample_depth, counters);
+		}
+
+		if(fragment_output.discard)
+			return false;
+
+		if(depth_test_mode == DepthTestMode::EarlyTestLateWrite)
+		{
+			fragment_output.depth = depth;
+			return set_framebuffer_output(position, sample_mask, fragment_output, sample_depth, counters);
+		}
+
+		//depth written by the shader replaces depth of every sample
+		float late_depth[MAX_SAMPLE_COUNT];
+		for(std::uint32_t mask = sample_mask; mask; mask &= mask - 1)
+		{
+			std::uint32_t sample = std::countr_zero(mask);
+			late_depth[sample] = fragment_output.depth;
+			if(late_depth_image && !is_depth_test_passed(late_depth_image, position, sample, fragment_output.depth))
+				sample_mask &= ~(1u << sample);
+		}
+
+		if(!sample_mask)
+		{
+			CountStatistic(counters.statistics.depth_rejected_fragments);
+			return false;
+		}
+
+		return set_framebuffer_output(position, sample_mask, fragment_output, late_depth, counters);
 	}
 
-	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD>
-	void
-	Pipeline<VO, ATTACHMENT_COUNT, SD>::set_framebuffer_output(Framebuffer &fb,
-															   const hrs::math::vector<std::int64_t, 2> &position,
-															   const FragmentOutput<ATTACHMENT_COUNT> &output,
-															   float depth)
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::depth_test_setup(Framebuffer &fb, const State &state)
+	{
+		const Image *depth_image = fb.GetDepthImage();
+		depth_compare = (state.depth_test_enable ? state.depth_compare : CompareOp::Always);
+		depth_format = (depth_image ? depth_image->GetFormat() : Format::DEPTH32_SFLOAT);
+		raster_block_kernel = GetRasterBlockKernel(depth_compare, depth_format);
+		depth_test_function = GetDepthTestFunction(depth_compare, depth_format);
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	void StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::output_merger_setup(Framebuffer &fb, const State &state)
 	{
-		for(std::size_t i = 0; i < output.attachments.size(); i++)
+		for(std::size_t i = 0; i < ATTACHMENT_COUNT; i++)
+			color_targets[i] = MakeColorTarget(fb.GetColorImage(i), state.blend_states[i]);
+
+		depth_target = MakeDepthTarget(fb.GetDepthImage(), state.depth_write_enable);
+	}
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename VS, typename FS>
+	bool StaticPipeline<VO, ATTACHMENT_COUNT, SD, VS, FS>::set_framebuffer_output(const hrs::math::vector<std::int64_t, 2> &position,
+																				  std::uint32_t sample_mask,
+																				  const FragmentOutput<ATTACHMENT_COUNT> &output,
+																				  const float *sample_depth,
+																				  ThreadCounters &counters)
+	{
+		counters.passed_samples += std::popcount(sample_mask);
+		CountStatistic(counters.statistics.written_pixels);
+
+		//position is inside of the draw rect, so texels are addressed directly
+		for(std::size_t i = 0; i < ATTACHMENT_COUNT; i++)
 		{
-			auto *color_img = fb.GetColorImage(i);
-			if(color_img)
-				color_img->SetValueColor(position[0], position[1], output.attachments[i]);
+			const ColorTarget &target = color_targets[i];
+			if(!target.data)
+				continue;
 
-			auto *depth_img = fb.GetDepthImage();
-			if(depth_img)
-				depth_img->SetValueDepth(position[0], position[1], depth);
+			if(!target.is_opaque)
+			{
+				//blending reads every sample since samples of a texel may differ
+				BlendColor(target, position[0], position[1], sample_mask, output.attachments[i]);
+
+				continue;
+			}
+
+			//opaque color is encoded once and stored to every covered sample
+			if(target.is_packed)
+			{
+				std::uint32_t packed_color = PackColor(target, output.attachments[i]);
+				for(std::uint32_t mask = sample_mask; mask; mask &= mask - 1)
+					*reinterpret_cast<std::uint32_t *>(target.GetTexel(position[0], position[1], std::countr_zero(mask))) = packed_color;
+			}
+			else
+			{
+				std::uint32_t first_sample = std::countr_zero(sample_mask);
+				std::byte *first_texel = target.GetTexel(position[0], position[1], first_sample);
+				SetFormatImageColor(target.format, first_texel, output.attachments[i]);
+				for(std::uint32_t mask = sample_mask & (sample_mask - 1); mask; mask &= mask - 1)
+					std::memcpy(target.GetTexel(position[0], position[1], std::countr_zero(mask)), first_texel, target.sample_pitch);
+			}
 		}
+
+		if(!depth_target.data)
+			return false;
+
+		for(std::uint32_t mask = sample_mask; mask; mask &= mask - 1)
+		{
+			std::uint32_t sample = std::countr_zero(mask);
+			depth_target.write(depth_target.GetTexel(position[0], position[1], sample), sample_depth[sample]);
+		}
+
+		return true;
+	}
+
+	//type erased pipeline for code which needs to choose shaders at runtime
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD>
+	class Pipeline : public StaticPipeline<VO,
+										   ATTACHMENT_COUNT,
+										   SD,
+										   std::function<VertexShaderType<VO, SD>>,
+										   std::function<FragmentShaderType<VO, ATTACHMENT_COUNT, SD>>>
+	{
+	public:
+		using StaticPipeline<VO,
+							 ATTACHMENT_COUNT,
+							 SD,
+							 std::function<VertexShaderType<VO, SD>>,
+							 std::function<FragmentShaderType<VO, ATTACHMENT_COUNT, SD>>>::StaticPipeline;
+	};
+
+	template<LinearInterpolatable VO, std::size_t ATTACHMENT_COUNT, typename SD, typename V, typename F>
+	StaticPipeline<VO, ATTACHMENT_COUNT, SD, std::decay_t<V>, std::decay_t<F>>
+	MakeStaticPipeline(std::size_t vertex_data_stride,
+					   V &&vertex_shader,
+					   F &&fragment_shader,
+					   hrs::flags<FragmentShaderFlags> fragment_shader_flags = FragmentShaderFlags::None,
+					   ThreadPool *thread_pool = nullptr)
+	{
+		return StaticPipeline<VO, ATTACHMENT_COUNT, SD, std::decay_t<V>, std::decay_t<F>>(vertex_data_stride,
+																						std::forward<V>(vertex_shader),
+																						std::forward<F>(fragment_shader),
+																						fragment_shader_flags,
+																						thread_pool);
 	}
 };
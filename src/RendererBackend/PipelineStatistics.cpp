@@ -0,0 +1,30 @@
+#include "PipelineStatistics.h"
+
+namespace Renderer
+{
+	std::string PipelineStatisticsToJson(const PipelineStatistics &statistics)
+	{
+		auto field = [](const char *name, std::uint64_t value)
+		{
+			return std::string("\"") + name + "\":" + std::to_string(value);
+		};
+
+		std::string json = "{";
+		json += field("culled_meshlets", statistics.culled_meshlets) + ",";
+		json += field("vertex_shader_invocations", statistics.vertex_shader_invocations) + ",";
+		json += field("clipper_input_primitives", statistics.clipper_input_primitives) + ",";
+		json += field("clipper_output_primitives", statistics.clipper_output_primitives) + ",";
+		json += "\"clip_results\":{";
+		json += field("trivially_accepted", statistics.GetClipResultCount(ClipResult::TriviallyAccepted)) + ",";
+		json += field("trivially_rejected", statistics.GetClipResultCount(ClipResult::TriviallyRejected)) + ",";
+		json += field("clipped", statistics.GetClipResultCount(ClipResult::Clipped)) + ",";
+		json += field("clipped_out", statistics.GetClipResultCount(ClipResult::ClippedOut)) + "},";
+		json += field("culled_primitives", statistics.culled_primitives) + ",";
+		json += field("fragment_shader_invocations", statistics.fragment_shader_invocations) + ",";
+		json += field("depth_rejected_fragments", statistics.depth_rejected_fragments) + ",";
+		json += field("written_pixels", statistics.written_pixels);
+		json += "}";
+
+		return json;
+	}
+};
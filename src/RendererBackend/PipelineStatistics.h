@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Polygon.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//statistics are gathered only if the renderer is built with RENDERER_PIPELINE_STATISTICS=1,
+//otherwise counting compiles to nothing and all counters stay zero
+#ifndef RENDERER_PIPELINE_STATISTICS
+#define RENDERER_PIPELINE_STATISTICS 0
+#endif
+
+namespace Renderer
+{
+	constexpr bool PIPELINE_STATISTICS_ENABLED = RENDERER_PIPELINE_STATISTICS;
+
+	constexpr std::size_t CLIP_RESULT_COUNT = 4;
+
+	struct PipelineStatistics
+	{
+		//meshlets skipped by the frustum or cone test before the vertex shading
+		std::uint64_t culled_meshlets;
+		std::uint64_t vertex_shader_invocations;
+		std::uint64_t clipper_input_primitives;
+		//primitives produced by the clipper(a clipped triangle is emitted as a fan of triangles)
+		std::uint64_t clipper_output_primitives;
+		//clipper input primitives by ClipResult
+		std::array<std::uint64_t, CLIP_RESULT_COUNT> clip_results;
+		//clipper output primitives dropped by the triangle(line) setup: face, zero area,
+		//no covered sample or out of the screen coordinate range
+		std::uint64_t culled_primitives;
+		std::uint64_t fragment_shader_invocations;
+		//covered pixels whose samples all failed the per pixel depth test(early or late).
+		//Blocks rejected by hierarchical z are not counted
+		std::uint64_t depth_rejected_fragments;
+		std::uint64_t written_pixels;
+
+		constexpr std::uint64_t GetClipResultCount(ClipResult result) const noexcept
+		{
+			return clip_results[static_cast<std::size_t>(result)];
+		}
+
+		constexpr PipelineStatistics & operator+=(const PipelineStatistics &statistics) noexcept
+		{
+			culled_meshlets += statistics.culled_meshlets;
+			vertex_shader_invocations += statistics.vertex_shader_invocations;
+			clipper_input_primitives += statistics.clipper_input_primitives;
+			clipper_output_primitives += statistics.clipper_output_primitives;
+			for(std::size_t i = 0; i < CLIP_RESULT_COUNT; i++)
+				clip_results[i] += statistics.clip_results[i];
+
+			culled_primitives += statistics.culled_primitives;
+			fragment_shader_invocations += statistics.fragment_shader_invocations;
+			depth_rejected_fragments += statistics.depth_rejected_fragments;
+			written_pixels += statistics.written_pixels;
+			return *this;
+		}
+	};
+
+	//adds value to the counter only if statistics are enabled
+	constexpr void CountStatistic(std::uint64_t &counter, std::uint64_t value = 1) noexcept
+	{
+		if constexpr(PIPELINE_STATISTICS_ENABLED)
+			counter += value;
+	}
+
+	//single JSON object with a field per counter, e.g. per frame totals of all pipelines
+	std::string PipelineStatisticsToJson(const PipelineStatistics &statistics);
+};
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "../hrs/flags.hpp"
 #include "../hrs/math/vector.hpp"
+#include <algorithm>
 #include <cassert>
+#include <limits>
 
 namespace Renderer
 {
@@ -53,10 +56,10 @@ namespace Renderer
 
 	enum class ClipResult
 	{
-		InsidePlane,
-		OutsidePlane,
-		OneResult,
-		TwoResult
+		TriviallyAccepted,//all vertices are inside of all planes
+		TriviallyRejected,//all vertices are outside of the same plane
+		Clipped,//polygon has been clipped and something is left
+		ClippedOut//polygon has been clipped and nothing is left
 	};
 
 	enum class ClipPlane
@@ -71,57 +74,61 @@ namespace Renderer
 		MAX_PLANE = 1 << 7
 	};
 
-	constexpr bool IsVertexOutside(ClipPlane plane, const hrs::math::glsl::vec4 &vertex) noexcept
+	constexpr inline std::size_t CLIP_PLANE_COUNT = 7;
+	//clipping of a convex polygon by one plane adds at most one vertex
+	constexpr inline std::size_t MAX_CLIP_VERTEX_COUNT = 3 + CLIP_PLANE_COUNT;
+
+	//bit of the outcode is set if vertex is outside of the plane.
+	//X and Y planes are placed at guard_band[0] * w and guard_band[1] * w, guard band of 1 means clipping by the viewport
+	constexpr hrs::flags<ClipPlane> ComputeOutcode(const hrs::math::glsl::vec4 &vertex,
+												   const hrs::math::glsl::vec2 &guard_band = {1.0f, 1.0f}) noexcept
 	{
-		switch(plane)
-		{
-			case ClipPlane::POSITIVE_W:
-				return vertex[3] < std::numeric_limits<float>::epsilon();
-				break;
-			case ClipPlane::POSITIVE_X:
-				return vertex[0] > vertex[3];
-				break;
-			case ClipPlane::NEGATIVE_X:
-				return vertex[0] < -vertex[3];
-				break;
-			case ClipPlane::POSITIVE_Y:
-				return vertex[1] > vertex[3];
-				break;
-			case ClipPlane::NEGATIVE_Y:
-				return vertex[1] < -vertex[3];
-				break;
-			case ClipPlane::POSITIVE_Z:
-				return vertex[2] > vertex[3];
-				break;
-			case ClipPlane::NEGATIVE_Z:
-				return vertex[2] < -vertex[3];
-				break;
-			default:
-				assert(false);
-				break;
-		}
+		float gw_x = guard_band[0] * vertex[3];
+		float gw_y = guard_band[1] * vertex[3];
+		hrs::flags<ClipPlane> outcode;
+		if(vertex[3] < std::numeric_limits<float>::epsilon())
+			outcode |= ClipPlane::POSITIVE_W;
+		if(vertex[0] > gw_x)
+			outcode |= ClipPlane::POSITIVE_X;
+		if(vertex[0] < -gw_x)
+			outcode |= ClipPlane::NEGATIVE_X;
+		if(vertex[1] > gw_y)
+			outcode |= ClipPlane::POSITIVE_Y;
+		if(vertex[1] < -gw_y)
+			outcode |= ClipPlane::NEGATIVE_Y;
+		if(vertex[2] > vertex[3])
+			outcode |= ClipPlane::POSITIVE_Z;
+		if(vertex[2] < -vertex[3])
+			outcode |= ClipPlane::NEGATIVE_Z;
+
+		return outcode;
 	}
 
 	constexpr float GetPlaneLerpFactor(ClipPlane plane,
 									  const hrs::math::glsl::vec4 &start,
-									  const hrs::math::glsl::vec4 &end) noexcept
+									  const hrs::math::glsl::vec4 &end,
+									  const hrs::math::glsl::vec2 &guard_band = {1.0f, 1.0f}) noexcept
 	{
+		float start_gw_x = guard_band[0] * start[3];
+		float end_gw_x = guard_band[0] * end[3];
+		float start_gw_y = guard_band[1] * start[3];
+		float end_gw_y = guard_band[1] * end[3];
 		switch(plane)
 		{
 			case ClipPlane::POSITIVE_W:
 				return (std::numeric_limits<float>::epsilon() - start[3]) / (end[3] - start[3]);
 				break;
 			case ClipPlane::POSITIVE_X:
-				return (start[0] - start[3]) / ((end[3] - start[3]) - (end[0] - start[0]));
+				return (start[0] - start_gw_x) / ((end_gw_x - start_gw_x) - (end[0] - start[0]));
 				break;
 			case ClipPlane::NEGATIVE_X:
-				return -(start[3] + start[0]) / ((end[0] - start[0]) + (end[3] - start[3]));
+				return -(start_gw_x + start[0]) / ((end[0] - start[0]) + (end_gw_x - start_gw_x));
 				break;
 			case ClipPlane::POSITIVE_Y:
-				return (start[1] - start[3]) / ((end[3] - start[3]) - (end[1] - start[1]));
+				return (start[1] - start_gw_y) / ((end_gw_y - start_gw_y) - (end[1] - start[1]));
 				break;
 			case ClipPlane::NEGATIVE_Y:
-				return -(start[3] + start[1]) / ((end[1] - start[1]) + (end[3] - start[3]));
+				return -(start_gw_y + start[1]) / ((end[1] - start[1]) + (end_gw_y - start_gw_y));
 				break;
 			case ClipPlane::POSITIVE_Z:
 				return (start[2] - start[3]) / ((end[3] - start[3]) - (end[2] - start[2]));
@@ -131,6 +138,7 @@ namespace Renderer
 				break;
 			default:
 				assert(false);
+				return 0.0f;
 				break;
 		}
 	}
@@ -148,87 +156,118 @@ namespace Renderer
 		Polygon(const Polygon &) = default;
 		Polygon & operator=(const Polygon &) = default;
 
-		ClipResult ClipAgainstPlane(ClipPlane plane, std::pair<Polygon<D>, Polygon<D>> &output) noexcept
+		//clips polygon with outcodes computed once per vertex.
+		//Trivially accepted and rejected polygons are not copied, otherwise the Sutherland-Hodgman
+		//algorithm runs over pointers to vertices and only intersection vertices are created.
+		//Resulting convex polygon(if any) is written to output and its vertex count to output_count
+		ClipResult Clip(const hrs::math::glsl::vec2 &guard_band,
+						Vertex<D> (&output)[MAX_CLIP_VERTEX_COUNT],
+						std::size_t &output_count) const noexcept
 		{
-			std::uint32_t outside_mask = 0;
+			hrs::flags<ClipPlane> codes[2][MAX_CLIP_VERTEX_COUNT];
 			for(int i = 0; i < 3; i++)
-				if(IsVertexOutside(plane, vertices[i].vertex))
-					outside_mask |= 1 << i;
-
-			if(std::popcount(outside_mask) == 0)
-				return ClipResult::InsidePlane;
-			else if(std::popcount(outside_mask) == 3)
-				return ClipResult::OutsidePlane;
-			else if(std::popcount(outside_mask) == 2)
-			{
-				int prev_index;
-				int target_index;
-				int post_index;
-				if(!(outside_mask & (1 << 0)))
-				{
-					target_index = 0;
-					prev_index = 2;
-					post_index = 1;
-				}
-				else if(!(outside_mask & (1 << 1)))
-				{
-					target_index = 1;
-					prev_index = 0;
-					post_index = 2;
-				}
-				else
-				{
-					target_index = 2;
-					prev_index = 1;
-					post_index = 0;
-				}
+				codes[0][i] = ComputeOutcode(vertices[i].vertex, guard_band);
 
-				float prev_t = GetPlaneLerpFactor(plane, vertices[prev_index].vertex, vertices[target_index].vertex);
-				float post_t = GetPlaneLerpFactor(plane, vertices[post_index].vertex, vertices[target_index].vertex);
+			output_count = 0;
+			if(codes[0][0] & codes[0][1] & codes[0][2])
+				return ClipResult::TriviallyRejected;
 
-				output.first.vertices[0] = Vertex<D>::Lerp(vertices[prev_index], vertices[target_index], prev_t);
-				output.first.vertices[1] = vertices[target_index];
-				output.first.vertices[2] = Vertex<D>::Lerp(vertices[post_index], vertices[target_index], post_t);
+			hrs::flags<ClipPlane> clip_mask = codes[0][0] | codes[0][1] | codes[0][2];
+			if(!clip_mask)
+				return ClipResult::TriviallyAccepted;
 
-				return ClipResult::OneResult;
-			}
-			else
+			//every plane adds at most two intersection vertices
+			Vertex<D> intersections[2 * CLIP_PLANE_COUNT];
+			std::size_t intersection_count = 0;
+
+			const Vertex<D> *buffers[2][MAX_CLIP_VERTEX_COUNT] = {{&vertices[0], &vertices[1], &vertices[2]}};
+			std::size_t count = 3;
+			int in = 0;
+			hrs::flags<ClipPlane> processed_planes;
+			for(hrs::flags<ClipPlane> plane = ClipPlane::POSITIVE_W; plane != ClipPlane::MAX_PLANE; plane <<= 1)
 			{
-				int prev_index;
-				int target_index;
-				int post_index;
-				if(outside_mask & (1 << 0))
-				{
-					target_index = 0;
-					prev_index = 2;
-					post_index = 1;
-				}
-				else if(outside_mask & (1 << 1))
-				{
-					target_index = 1;
-					prev_index = 0;
-					post_index = 2;
-				}
-				else
-				{
-					target_index = 2;
-					prev_index = 1;
-					post_index = 0;
-				}
+				if(!(plane & clip_mask))
+					continue;
 
-				float prev_t = GetPlaneLerpFactor(plane, vertices[target_index].vertex, vertices[prev_index].vertex);
-				float post_t = GetPlaneLerpFactor(plane, vertices[target_index].vertex, vertices[post_index].vertex);
+				processed_planes |= plane;
+				int out = 1 - in;
+				std::size_t out_count = 0;
+				for(std::size_t i = 0; i < count; i++)
+				{
+					std::size_t next = (i + 1 == count ? 0 : i + 1);
+					bool is_current_outside = static_cast<bool>(codes[in][i] & plane);
+					bool is_next_outside = static_cast<bool>(codes[in][next] & plane);
+					if(!is_current_outside)
+					{
+						buffers[out][out_count] = buffers[in][i];
+						codes[out][out_count] = codes[in][i];
+						out_count++;
+					}
 
-				output.first.vertices[0] = vertices[prev_index];
-				output.first.vertices[1] = Vertex<D>::Lerp(vertices[target_index], vertices[prev_index], prev_t);
-				output.first.vertices[2] = vertices[post_index];
+					if(is_current_outside != is_next_outside)
+					{
+						//interpolation always goes from the inside vertex, so an edge shared by two
+						//polygons produces exactly the same intersection for both of them
+						const Vertex<D> *inside = (is_current_outside ? buffers[in][next] : buffers[in][i]);
+						const Vertex<D> *outside = (is_current_outside ? buffers[in][i] : buffers[in][next]);
+						float t = GetPlaneLerpFactor(plane, inside->vertex, outside->vertex, guard_band);
 
-				output.second.vertices[0] = vertices[post_index];
-				output.second.vertices[1] = output.first.vertices[1];
-				output.second.vertices[2] = Vertex<D>::Lerp(vertices[target_index], vertices[post_index], post_t);
+						Vertex<D> &intersection = intersections[intersection_count++];
+						intersection = Vertex<D>::Lerp(*inside, *outside, t);
+						buffers[out][out_count] = &intersection;
+						codes[out][out_count] = ComputeOutcode(intersection.vertex, guard_band) & ~processed_planes;
+						out_count++;
+					}
+				}
 
-				return ClipResult::TwoResult;
+				in = out;
+				count = out_count;
+				if(count < 3)
+					return ClipResult::ClippedOut;
 			}
+
+			for(std::size_t i = 0; i < count; i++)
+				output[i] = *buffers[in][i];
+
+			output_count = count;
+			return ClipResult::Clipped;
 		}
 	};
+
+	//parametric clipping of a segment by the same planes as polygons,
+	//ends which are outside are moved to the intersection points
+	template<LinearInterpolatable D>
+	ClipResult ClipLine(Vertex<D> &start, Vertex<D> &end, const hrs::math::glsl::vec2 &guard_band) noexcept
+	{
+		hrs::flags<ClipPlane> start_code = ComputeOutcode(start.vertex, guard_band);
+		hrs::flags<ClipPlane> end_code = ComputeOutcode(end.vertex, guard_band);
+		if(start_code & end_code)
+			return ClipResult::TriviallyRejected;
+
+		hrs::flags<ClipPlane> clip_mask = start_code | end_code;
+		if(!clip_mask)
+			return ClipResult::TriviallyAccepted;
+
+		float t0 = 0.0f;
+		float t1 = 1.0f;
+		for(hrs::flags<ClipPlane> plane = ClipPlane::POSITIVE_W; plane != ClipPlane::MAX_PLANE; plane <<= 1)
+		{
+			if(!(plane & clip_mask))
+				continue;
+
+			float t = GetPlaneLerpFactor(plane, start.vertex, end.vertex, guard_band);
+			if(start_code & plane)
+				t0 = std::max(t0, t);
+			else
+				t1 = std::min(t1, t);
+		}
+
+		if(!(t0 < t1))
+			return ClipResult::ClippedOut;
+
+		Vertex<D> clipped_start = Vertex<D>::Lerp(start, end, t0);
+		end = Vertex<D>::Lerp(start, end, t1);
+		start = clipped_start;
+		return ClipResult::Clipped;
+	}
 };
@@ -0,0 +1,350 @@
+#include "RasterKernels.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RENDERER_RASTER_KERNELS_X86
+#endif
+
+namespace Renderer
+{
+	namespace
+	{
+		constexpr std::uint32_t lane_count_mask(std::uint32_t lane_count) noexcept
+		{
+			return (lane_count >= 32 ? ~0u : (1u << lane_count) - 1);
+		}
+
+		//partial blocks are copied to a zero padded buffer so kernels always load whole blocks,
+		//lanes beyond lane_count are masked off
+		template<Format FORMAT>
+		const std::byte * pad_depth(const std::byte *depth, std::uint32_t lane_count, std::byte *padded) noexcept
+		{
+			constexpr std::size_t texel_size = GetFormatTexelSize(FORMAT);
+			if(!depth || lane_count == RASTER_BLOCK_SIZE)
+				return depth;
+
+			std::memcpy(padded, depth, lane_count * texel_size);
+			std::memset(padded + lane_count * texel_size, 0, (RASTER_BLOCK_SIZE - lane_count) * texel_size);
+			return padded;
+		}
+
+		template<CompareOp OP, Format FORMAT>
+		std::uint32_t raster_block_scalar(const RasterSpan &span,
+										  const RasterBlockStart &start,
+										  const std::byte *depth,
+										  std::uint32_t lane_count,
+										  float *out_z,
+										  float *out_w) noexcept
+		{
+			constexpr std::size_t texel_size = GetFormatTexelSize(FORMAT);
+			std::uint32_t mask = 0;
+			for(std::uint32_t i = 0; i < lane_count; i++)
+			{
+				float offset = static_cast<float>(i);
+				bool inside = true;
+				for(int j = 0; j < 3; j++)
+					inside = inside && start.e[j] + span.edge_dx[j] * static_cast<std::int32_t>(i) >= 0;
+
+				float z = start.z + span.dz_dx * offset;
+				out_z[i] = z;
+				out_w[i] = start.w + span.dw_dx * offset;
+
+				if(inside &&
+				   (!depth || CompareDepth(OP,
+										   GetDepthCompareValue<FORMAT>(z),
+										   LoadDepthCompareValue<FORMAT>(depth + i * texel_size))))
+					mask |= 1u << i;
+			}
+
+			return mask;
+		}
+
+#ifdef RENDERER_RASTER_KERNELS_X86
+		//SSE and AVX2 versions of GetDepthCompareValue/LoadDepthCompareValue with the same float operations
+		template<Format FORMAT>
+		__m128 get_depth_compare_value_sse(__m128 z) noexcept
+		{
+			if constexpr(FORMAT == Format::DEPTH32_SFLOAT)
+				return z;
+			else
+			{
+				const __m128 scale = _mm_set1_ps(GetFormatDepthUnormScale(FORMAT));
+				__m128 clamped = _mm_min_ps(_mm_max_ps(z, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+				__m128 code = _mm_min_ps(_mm_add_ps(_mm_mul_ps(clamped, scale), _mm_set1_ps(0.5f)), scale);
+				return _mm_cvtepi32_ps(_mm_cvttps_epi32(code));
+			}
+		}
+
+		template<Format FORMAT>
+		__m128 load_depth_compare_value_sse(const std::byte *texels) noexcept
+		{
+			if constexpr(FORMAT == Format::DEPTH32_SFLOAT)
+				return _mm_loadu_ps(reinterpret_cast<const float *>(texels));
+			else if constexpr(FORMAT == Format::DEPTH16_UNORM)
+			{
+				__m128i codes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(texels));
+				return _mm_cvtepi32_ps(_mm_unpacklo_epi16(codes, _mm_setzero_si128()));
+			}
+			else
+			{
+				__m128i codes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(texels));
+				return _mm_cvtepi32_ps(_mm_and_si128(codes, _mm_set1_epi32(0xFFFFFF)));
+			}
+		}
+
+		template<CompareOp OP>
+		__m128 compare_depth_sse(__m128 depth, __m128 stored_depth) noexcept
+		{
+			if constexpr(OP == CompareOp::Never)
+				return _mm_setzero_ps();
+			else if constexpr(OP == CompareOp::Less)
+				return _mm_cmplt_ps(depth, stored_depth);
+			else if constexpr(OP == CompareOp::Equal)
+				return _mm_cmpeq_ps(depth, stored_depth);
+			else if constexpr(OP == CompareOp::LessOrEqual)
+				return _mm_cmple_ps(depth, stored_depth);
+			else if constexpr(OP == CompareOp::Greater)
+				return _mm_cmpgt_ps(depth, stored_depth);
+			else if constexpr(OP == CompareOp::NotEqual)
+				return _mm_cmpneq_ps(depth, stored_depth);
+			else if constexpr(OP == CompareOp::GreaterOrEqual)
+				return _mm_cmpge_ps(depth, stored_depth);
+			else
+				return _mm_castsi128_ps(_mm_set1_epi32(-1));
+		}
+
+		template<CompareOp OP, Format FORMAT>
+		std::uint32_t raster_block_sse(const RasterSpan &span,
+									   const RasterBlockStart &start,
+									   const std::byte *depth,
+									   std::uint32_t lane_count,
+									   float *out_z,
+									   float *out_w) noexcept
+		{
+			constexpr std::size_t texel_size = GetFormatTexelSize(FORMAT);
+			alignas(16) std::byte padded[RASTER_BLOCK_SIZE * texel_size];
+			depth = pad_depth<FORMAT>(depth, lane_count, padded);
+
+			//SSE2 has no 32 bit multiply, so lane offsets of the edges are built with additions
+			__m128i e[3];
+			__m128i half_step[3];
+			for(int j = 0; j < 3; j++)
+			{
+				std::int32_t dx = span.edge_dx[j];
+				e[j] = _mm_add_epi32(_mm_set1_epi32(start.e[j]), _mm_setr_epi32(0, dx, dx * 2, dx * 3));
+				half_step[j] = _mm_set1_epi32(dx * 4);
+			}
+
+			std::uint32_t mask = 0;
+			for(std::uint32_t half = 0; half < RASTER_BLOCK_SIZE; half += 4)
+			{
+				__m128 offset = _mm_setr_ps(half + 0.0f, half + 1.0f, half + 2.0f, half + 3.0f);
+				//pixel is covered if no edge value has the sign bit set
+				__m128i outside = _mm_or_si128(_mm_or_si128(e[0], e[1]), e[2]);
+				__m128 inside = _mm_castsi128_ps(_mm_cmpgt_epi32(outside, _mm_set1_epi32(-1)));
+				for(int j = 0; j < 3; j++)
+					e[j] = _mm_add_epi32(e[j], half_step[j]);
+
+				__m128 z = _mm_add_ps(_mm_set1_ps(start.z), _mm_mul_ps(_mm_set1_ps(span.dz_dx), offset));
+				__m128 w = _mm_add_ps(_mm_set1_ps(start.w), _mm_mul_ps(_mm_set1_ps(span.dw_dx), offset));
+				_mm_storeu_ps(out_z + half, z);
+				_mm_storeu_ps(out_w + half, w);
+
+				if(depth)
+					inside = _mm_and_ps(inside,
+										compare_depth_sse<OP>(get_depth_compare_value_sse<FORMAT>(z),
+															  load_depth_compare_value_sse<FORMAT>(depth + half * texel_size)));
+
+				mask |= static_cast<std::uint32_t>(_mm_movemask_ps(inside)) << half;
+			}
+
+			return mask & lane_count_mask(lane_count);
+		}
+
+		template<Format FORMAT>
+		__attribute__((target("avx2")))
+		__m256 get_depth_compare_value_avx2(__m256 z) noexcept
+		{
+			if constexpr(FORMAT == Format::DEPTH32_SFLOAT)
+				return z;
+			else
+			{
+				const __m256 scale = _mm256_set1_ps(GetFormatDepthUnormScale(FORMAT));
+				__m256 clamped = _mm256_min_ps(_mm256_max_ps(z, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+				__m256 code = _mm256_min_ps(_mm256_add_ps(_mm256_mul_ps(clamped, scale), _mm256_set1_ps(0.5f)), scale);
+				return _mm256_cvtepi32_ps(_mm256_cvttps_epi32(code));
+			}
+		}
+
+		template<Format FORMAT>
+		__attribute__((target("avx2")))
+		__m256 load_depth_compare_value_avx2(const std::byte *texels) noexcept
+		{
+			if constexpr(FORMAT == Format::DEPTH32_SFLOAT)
+				return _mm256_loadu_ps(reinterpret_cast<const float *>(texels));
+			else if constexpr(FORMAT == Format::DEPTH16_UNORM)
+			{
+				__m128i codes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(texels));
+				return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(codes));
+			}
+			else
+			{
+				__m256i codes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(texels));
+				return _mm256_cvtepi32_ps(_mm256_and_si256(codes, _mm256_set1_epi32(0xFFFFFF)));
+			}
+		}
+
+		template<CompareOp OP>
+		__attribute__((target("avx2")))
+		__m256 compare_depth_avx2(__m256 depth, __m256 stored_depth) noexcept
+		{
+			if constexpr(OP == CompareOp::Never)
+				return _mm256_setzero_ps();
+			else if constexpr(OP == CompareOp::Less)
+				return _mm256_cmp_ps(depth, stored_depth, _CMP_LT_OQ);
+			else if constexpr(OP == CompareOp::Equal)
+				return _mm256_cmp_ps(depth, stored_depth, _CMP_EQ_OQ);
+			else if constexpr(OP == CompareOp::LessOrEqual)
+				return _mm256_cmp_ps(depth, stored_depth, _CMP_LE_OQ);
+			else if constexpr(OP == CompareOp::Greater)
+				return _mm256_cmp_ps(depth, stored_depth, _CMP_GT_OQ);
+			else if constexpr(OP == CompareOp::NotEqual)
+				return _mm256_cmp_ps(depth, stored_depth, _CMP_NEQ_UQ);
+			else if constexpr(OP == CompareOp::GreaterOrEqual)
+				return _mm256_cmp_ps(depth, stored_depth, _CMP_GE_OQ);
+			else
+				return _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		}
+
+		template<CompareOp OP, Format FORMAT>
+		__attribute__((target("avx2")))
+		std::uint32_t raster_block_avx2(const RasterSpan &span,
+									   const RasterBlockStart &start,
+									   const std::byte *depth,
+									   std::uint32_t lane_count,
+									   float *out_z,
+									   float *out_w) noexcept
+		{
+			alignas(32) std::byte padded[RASTER_BLOCK_SIZE * GetFormatTexelSize(FORMAT)];
+			depth = pad_depth<FORMAT>(depth, lane_count, padded);
+
+			const __m256 offset = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+			const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+			__m256i outside = _mm256_setzero_si256();
+			for(int j = 0; j < 3; j++)
+			{
+				__m256i e = _mm256_add_epi32(_mm256_set1_epi32(start.e[j]),
+											 _mm256_mullo_epi32(_mm256_set1_epi32(span.edge_dx[j]), lanes));
+				outside = _mm256_or_si256(outside, e);
+			}
+
+			//pixel is covered if no edge value has the sign bit set
+			__m256 inside = _mm256_castsi256_ps(_mm256_cmpgt_epi32(outside, _mm256_set1_epi32(-1)));
+
+			__m256 z = _mm256_add_ps(_mm256_set1_ps(start.z), _mm256_mul_ps(_mm256_set1_ps(span.dz_dx), offset));
+			__m256 w = _mm256_add_ps(_mm256_set1_ps(start.w), _mm256_mul_ps(_mm256_set1_ps(span.dw_dx), offset));
+			_mm256_storeu_ps(out_z, z);
+			_mm256_storeu_ps(out_w, w);
+
+			if(depth)
+				inside = _mm256_and_ps(inside,
+									   compare_depth_avx2<OP>(get_depth_compare_value_avx2<FORMAT>(z),
+															  load_depth_compare_value_avx2<FORMAT>(depth)));
+
+			return static_cast<std::uint32_t>(_mm256_movemask_ps(inside)) & lane_count_mask(lane_count);
+		}
+#endif
+
+		template<CompareOp OP, Format FORMAT>
+		RasterBlockKernel get_raster_block_kernel(RasterKernelType type) noexcept
+		{
+			switch(type)
+			{
+#ifdef RENDERER_RASTER_KERNELS_X86
+				case RasterKernelType::AVX2:
+					return raster_block_avx2<OP, FORMAT>;
+					break;
+				case RasterKernelType::SSE:
+					return raster_block_sse<OP, FORMAT>;
+					break;
+#endif
+				default:
+					return raster_block_scalar<OP, FORMAT>;
+					break;
+			}
+		}
+
+		template<Format FORMAT>
+		RasterBlockKernel get_raster_block_kernel(RasterKernelType type, CompareOp op) noexcept
+		{
+			switch(op)
+			{
+				case CompareOp::Never:
+					return get_raster_block_kernel<CompareOp::Never, FORMAT>(type);
+					break;
+				case CompareOp::Less:
+					return get_raster_block_kernel<CompareOp::Less, FORMAT>(type);
+					break;
+				case CompareOp::Equal:
+					return get_raster_block_kernel<CompareOp::Equal, FORMAT>(type);
+					break;
+				case CompareOp::LessOrEqual:
+					return get_raster_block_kernel<CompareOp::LessOrEqual, FORMAT>(type);
+					break;
+				case CompareOp::Greater:
+					return get_raster_block_kernel<CompareOp::Greater, FORMAT>(type);
+					break;
+				case CompareOp::NotEqual:
+					return get_raster_block_kernel<CompareOp::NotEqual, FORMAT>(type);
+					break;
+				case CompareOp::GreaterOrEqual:
+					return get_raster_block_kernel<CompareOp::GreaterOrEqual, FORMAT>(type);
+					break;
+				default:
+					return get_raster_block_kernel<CompareOp::Always, FORMAT>(type);
+					break;
+			}
+		}
+
+		RasterKernelType detect_raster_kernel_type() noexcept
+		{
+#ifdef RENDERER_RASTER_KERNELS_X86
+			__builtin_cpu_init();
+			if(__builtin_cpu_supports("avx2"))
+				return RasterKernelType::AVX2;
+
+			if(__builtin_cpu_supports("sse2"))
+				return RasterKernelType::SSE;
+#endif
+			return RasterKernelType::Scalar;
+		}
+	};
+
+	RasterKernelType GetRasterKernelType() noexcept
+	{
+		static const RasterKernelType type = detect_raster_kernel_type();
+		return type;
+	}
+
+	RasterBlockKernel GetRasterBlockKernel(CompareOp op, Format depth_format) noexcept
+	{
+		return GetRasterBlockKernel(GetRasterKernelType(), op, depth_format);
+	}
+
+	RasterBlockKernel GetRasterBlockKernel(RasterKernelType type, CompareOp op, Format depth_format) noexcept
+	{
+		switch(depth_format)
+		{
+			case Format::DEPTH16_UNORM:
+				return get_raster_block_kernel<Format::DEPTH16_UNORM>(type, op);
+				break;
+			case Format::DEPTH24_UNORM:
+				return get_raster_block_kernel<Format::DEPTH24_UNORM>(type, op);
+				break;
+			default:
+				return get_raster_block_kernel<Format::DEPTH32_SFLOAT>(type, op);
+				break;
+		}
+	}
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "DepthTest.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace Renderer
+{
+	//count of pixels processed by one call of a raster block kernel
+	constexpr inline std::uint32_t RASTER_BLOCK_SIZE = 8;
+
+	//edge values passed to kernels are clamped to +-RASTER_EDGE_CLAMP. It is far above
+	//RASTER_BLOCK_SIZE * |edge_dx| for 16.8 fixed point coordinates, so clamping never changes
+	//the sign of an edge inside a block and kernels run in 32 bit integers
+	constexpr inline std::int32_t RASTER_EDGE_CLAMP = std::int32_t{1} << 29;
+
+	//per triangle constants of the fill rasterizer
+	struct RasterSpan
+	{
+		std::int32_t edge_dx[3];//edge step per pixel divided by the sub pixel scale
+		float dz_dx;
+		float dw_dx;
+	};
+
+	//values at the first pixel of a block.
+	//e is floor((E - bias) / sub pixel scale) where E is the exact fixed point edge function
+	//and bias is 0 for top-left edges and 1 otherwise, so pixel is covered if every e >= 0
+	struct RasterBlockStart
+	{
+		std::int32_t e[3];
+		float z;
+		float w;
+	};
+
+	//evaluates edge functions, z and 1/w for lane_count(<= RASTER_BLOCK_SIZE) pixels of a row,
+	//tests z against texels of the depth row (if depth is not null) and returns the mask of covered pixels
+	//which passed the depth test. z and 1/w of every lane are written to out_z and out_w
+	using RasterBlockKernel = std::uint32_t (*)(const RasterSpan &span,
+												const RasterBlockStart &start,
+												const std::byte *depth,
+												std::uint32_t lane_count,
+												float *out_z,
+												float *out_w) noexcept;
+
+	enum class RasterKernelType
+	{
+		Scalar,
+		SSE,
+		AVX2
+	};
+
+	//kernel type is selected once from CPUID.
+	//Kernels are specialized for the compare op and the depth format(DEPTH32_SFLOAT, LessOrEqual by default)
+	RasterKernelType GetRasterKernelType() noexcept;
+	RasterBlockKernel GetRasterBlockKernel(CompareOp op = CompareOp::LessOrEqual,
+										   Format depth_format = Format::DEPTH32_SFLOAT) noexcept;
+	RasterBlockKernel GetRasterBlockKernel(RasterKernelType type,
+										   CompareOp op = CompareOp::LessOrEqual,
+										   Format depth_format = Format::DEPTH32_SFLOAT) noexcept;
+};
@@ -0,0 +1,103 @@
+#include "ThreadPool.h"
+#include "../Profiler/Profiler.h"
+#include <algorithm>
+
+namespace Renderer
+{
+	ThreadPool::ThreadPool(std::size_t _thread_count)
+		: job(nullptr),
+		  job_context(nullptr),
+		  job_count(0),
+		  next_index(0),
+		  active_workers(0),
+		  generation(0),
+		  is_stopping(false)
+	{
+		if(_thread_count == 0)
+			_thread_count = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+
+		workers.reserve(_thread_count - 1);
+		for(std::size_t i = 1; i < _thread_count; i++)
+			workers.emplace_back(&ThreadPool::worker_loop, this, i);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard lock(mutex);
+			is_stopping = true;
+		}
+
+		start_cv.notify_all();
+		for(auto &worker : workers)
+			worker.join();
+	}
+
+	std::size_t ThreadPool::GetThreadCount() const noexcept
+	{
+		return workers.size() + 1;
+	}
+
+	void ThreadPool::dispatch(std::size_t count, Job _job, void *context)
+	{
+		if(count == 0)
+			return;
+
+		std::lock_guard dispatch_lock(dispatch_mutex);
+		if(workers.empty() || count == 1)
+		{
+			for(std::size_t i = 0; i < count; i++)
+				_job(context, i, 0);
+
+			return;
+		}
+
+		{
+			std::lock_guard lock(mutex);
+			job = _job;
+			job_context = context;
+			job_count = count;
+			next_index.store(0, std::memory_order_relaxed);
+			active_workers = workers.size();
+			generation++;
+		}
+
+		start_cv.notify_all();
+		run_job(0);
+
+		std::unique_lock lock(mutex);
+		finish_cv.wait(lock, [this]{ return active_workers == 0; });
+		job = nullptr;
+		job_context = nullptr;
+	}
+
+	void ThreadPool::run_job(std::size_t thread_index)
+	{
+		std::size_t index;
+		while((index = next_index.fetch_add(1, std::memory_order_relaxed)) < job_count)
+			job(job_context, index, thread_index);
+	}
+
+	void ThreadPool::worker_loop(std::size_t thread_index)
+	{
+		PROFILER_THREAD_NAME("ThreadPool worker");
+		std::uint64_t seen_generation = 0;
+		while(true)
+		{
+			{
+				std::unique_lock lock(mutex);
+				start_cv.wait(lock, [&]{ return is_stopping || generation != seen_generation; });
+				if(is_stopping)
+					return;
+
+				seen_generation = generation;
+			}
+
+			run_job(thread_index);
+
+			std::lock_guard lock(mutex);
+			if(--active_workers == 0)
+				finish_cv.notify_one();
+		}
+	}
+};
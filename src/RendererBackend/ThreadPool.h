@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <concepts>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Renderer
+{
+	class ThreadPool
+	{
+	public:
+		//thread count includes the calling thread, zero means hardware concurrency
+		ThreadPool(std::size_t _thread_count = {});
+		~ThreadPool();
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool(ThreadPool &&) = delete;
+		ThreadPool & operator=(const ThreadPool &) = delete;
+		ThreadPool & operator=(ThreadPool &&) = delete;
+
+		std::size_t GetThreadCount() const noexcept;
+
+		//calls func(index, thread_index) for every index in [0, count) and blocks until all calls are done.
+		//The calling thread takes part in the work with thread_index = 0.
+		//Dispatch must not be called from inside of a dispatched function
+		template<std::invocable<std::size_t, std::size_t> F>
+		void Dispatch(std::size_t count, F &&func);
+
+	private:
+		using Job = void (*)(void *context, std::size_t index, std::size_t thread_index);
+
+		void dispatch(std::size_t count, Job job, void *context);
+		void run_job(std::size_t thread_index);
+		void worker_loop(std::size_t thread_index);
+
+		std::vector<std::thread> workers;
+
+		std::mutex dispatch_mutex;
+		std::mutex mutex;
+		std::condition_variable start_cv;
+		std::condition_variable finish_cv;
+
+		Job job;
+		void *job_context;
+		std::size_t job_count;
+		std::atomic<std::size_t> next_index;
+		std::size_t active_workers;
+		std::uint64_t generation;
+		bool is_stopping;
+	};
+
+	template<std::invocable<std::size_t, std::size_t> F>
+	void ThreadPool::Dispatch(std::size_t count, F &&func)
+	{
+		auto invoke = [](void *context, std::size_t index, std::size_t thread_index)
+		{
+			(*static_cast<std::remove_reference_t<F> *>(context))(index, thread_index);
+		};
+
+		dispatch(count, invoke, const_cast<void *>(static_cast<const void *>(&func)));
+	}
+};
@@ -44,4 +44,13 @@ namespace Renderer
 	{
 		return max_depth;
 	}
+
+	Scissor::Scissor(std::uint32_t _width,
+					 std::uint32_t _height,
+					 std::uint32_t _x,
+					 std::uint32_t _y) noexcept
+		: width(_width),
+		  height(_height),
+		  x(_x),
+		  y(_y) {}
 };
@@ -30,4 +30,21 @@ namespace Renderer
 		float GetMinDepth() const noexcept;
 		float GetMaxDepth() const noexcept;
 	};
+
+	//pixels outside of the rect are not rasterized
+	struct Scissor
+	{
+		std::uint32_t width;
+		std::uint32_t height;
+		std::uint32_t x;
+		std::uint32_t y;
+
+		Scissor(std::uint32_t _width = {},
+				std::uint32_t _height = {},
+				std::uint32_t _x = {},
+				std::uint32_t _y = {}) noexcept;
+
+		Scissor(const Scissor &) = default;
+		Scissor & operator=(const Scissor &) = default;
+	};
 };
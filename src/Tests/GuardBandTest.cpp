@@ -0,0 +1,147 @@
+#include "../RendererBackend/CommandQueue.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+//primitives which cross the guard band of a viewport larger than MAX_SCREEN_COORDINATE / (guard_band + 1)
+//must be clipped before the setup instead of being dropped by it
+using namespace Renderer;
+
+struct Varyings
+{
+	float value = 0.0f;
+
+	Varyings & operator*=(float v) noexcept { value *= v; return *this; }
+	Varyings operator*(float v) const noexcept { return {value * v}; }
+	Varyings operator/(std::int64_t v) const noexcept { return {value / v}; }
+	Varyings operator-(const Varyings &v) const noexcept { return {value - v.value}; }
+	Varyings operator+(const Varyings &v) const noexcept { return {value + v.value}; }
+	Varyings & operator+=(const Varyings &v) noexcept { value += v.value; return *this; }
+};
+
+struct ShaderData {};
+
+struct TestVertex
+{
+	float x;
+	float y;
+};
+
+constexpr std::uint32_t IMAGE_SIZE = 64;
+//half extent of 8192 narrows the default guard band of 4 to ~3
+constexpr std::uint32_t VIEWPORT_SIZE = 16384;
+
+static std::size_t count_written_pixels(const Image &image, std::uint32_t max_y)
+{
+	std::size_t count = 0;
+	for(std::uint32_t y = 0; y <= max_y; y++)
+		for(std::uint32_t x = 0; x < IMAGE_SIZE; x++)
+			if(image.GetValueColor(x, y, 0)[0] != 0.0f)
+				count++;
+
+	return count;
+}
+
+static bool run(ThreadPool *thread_pool)
+{
+	auto vertex_shader = [](std::uint32_t, std::uint32_t, const std::byte *vertex, const std::byte *, Varyings &, ShaderData &)
+	{
+		const TestVertex *v = reinterpret_cast<const TestVertex *>(vertex);
+		return hrs::math::glsl::vec4(v->x, v->y, 0.5f, 1.0f);
+	};
+
+	auto fragment_shader = [](const Varyings &,
+							  const FragmentDerivatives<Varyings> &,
+							  const hrs::math::vector<std::int64_t, 2> &,
+							  float,
+							  FragmentOutput<1> &output,
+							  ShaderData &)
+	{
+		output.attachments[0] = hrs::math::glsl::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+	};
+
+	auto pipeline = MakeStaticPipeline<Varyings, 1, ShaderData>(sizeof(TestVertex),
+																 vertex_shader,
+																 fragment_shader,
+																 FragmentShaderFlags::None,
+																 thread_pool);
+
+	Image color_image(IMAGE_SIZE, IMAGE_SIZE, Format::RGBA32_PACKED);
+	Image *color_images[] = {&color_image};
+	Framebuffer fb(color_images);
+	ShaderData shader_data;
+	State state(RasterizationTopology::Fill, false, Viewport(VIEWPORT_SIZE, VIEWPORT_SIZE, 0, 0, 0.0f, 1.0f));
+
+	//the image is the top left corner of the viewport, so every triangle covers all of its pixels.
+	//X of the second vertex is inside of the guard band of 4, but beyond MAX_SCREEN_COORDINATE
+	const TestVertex crossing_triangle[] = {{-1.5f, 1.5f}, {3.9f, 1.5f}, {-1.5f, -1.5f}};
+	//same in Y
+	const TestVertex crossing_triangle_y[] = {{-1.5f, 1.5f}, {1.5f, 1.5f}, {-1.5f, -3.9f}};
+	//inside of the narrowed guard band, so it is not clipped
+	const TestVertex inner_triangle[] = {{-1.5f, 1.5f}, {2.9f, 1.5f}, {-1.5f, -1.5f}};
+	//horizontal line through the centers of the first row
+	const float first_row_y = 1.0f - 0.5f / (VIEWPORT_SIZE / 2);
+	const TestVertex crossing_line[] = {{-1.5f, first_row_y}, {3.9f, first_row_y}};
+	const std::uint32_t line_indices[] = {0, 1};
+
+	struct Case
+	{
+		const char *name;
+		const TestVertex *vertices;
+		std::size_t count;
+		std::uint32_t max_y;
+	};
+
+	const Case cases[] = {{"crossing triangle", crossing_triangle, 3, IMAGE_SIZE - 1},
+						  {"crossing triangle y", crossing_triangle_y, 3, IMAGE_SIZE - 1},
+						  {"inner triangle", inner_triangle, 3, IMAGE_SIZE - 1},
+						  {"crossing line", crossing_line, 2, 0}};
+
+	bool is_passed = true;
+	CommandQueue queue;
+	for(const Case &c : cases)
+	{
+		CommandBuffer command_buffer;
+		command_buffer.ClearImage(ClearValue{.color = hrs::math::glsl::vec4(0.0f, 0.0f, 0.0f, 0.0f)}, 0);
+		if(c.count == 2)
+		{
+			state.topology = RasterizationTopology::Line;
+			command_buffer.SetState(state);
+			command_buffer.DrawIndexedLines(pipeline,
+											reinterpret_cast<const std::byte *>(c.vertices),
+											line_indices,
+											2,
+											shader_data);
+		}
+		else
+		{
+			state.topology = RasterizationTopology::Fill;
+			command_buffer.SetState(state);
+			command_buffer.Draw(pipeline, reinterpret_cast<const std::byte *>(c.vertices), c.count, shader_data);
+		}
+
+		queue.Submit(command_buffer, fb).Wait();
+
+		std::size_t expected_count = (c.max_y + 1) * IMAGE_SIZE;
+		std::size_t count = count_written_pixels(color_image, c.max_y);
+		if(count != expected_count)
+		{
+			std::printf("%s(%s): %zu of %zu pixels written\n",
+						c.name,
+						(thread_pool ? "binned" : "immediate"),
+						count,
+						expected_count);
+			is_passed = false;
+		}
+	}
+
+	return is_passed;
+}
+
+int main()
+{
+	ThreadPool thread_pool(4);
+	bool is_passed = run(nullptr);
+	is_passed = run(&thread_pool) && is_passed;
+	return (is_passed ? EXIT_SUCCESS : EXIT_FAILURE);
+}
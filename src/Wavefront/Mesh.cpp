@@ -1,4 +1,5 @@
 #include "Mesh.h"
+#include "../Profiler/Profiler.h"
 #include <map>
 #include <cassert>
 
@@ -59,6 +60,7 @@ namespace hrs
 
 MeshVertexIndexData Mesh::CreateData() const
 {
+	PROFILER_ZONE("Mesh::CreateData");
 	MeshVertexIndexData out_data;
 	out_data.part_indices.reserve(parts.size());
 	std::size_t reserve_vert = 0;
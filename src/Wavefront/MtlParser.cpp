@@ -1,4 +1,5 @@
 #include "MtlParser.h"
+#include "../Profiler/Profiler.h"
 #include "Common.hpp"
 
 MtlParser::~MtlParser()
@@ -8,6 +9,7 @@ MtlParser::~MtlParser()
 
 MaterialLib MtlParser::Parse(const std::filesystem::path &file_name, std::string_view material_lib_name)
 {
+	PROFILER_ZONE("MtlParser::Parse");
 	fs.open(file_name);
 	if(!fs.is_open())
 		throw MtlParserError(MtlParserResult::BadFile, 0);
@@ -1,5 +1,6 @@
 #include "ObjParser.h"
 #include "Common.hpp"
+#include "../Profiler/Profiler.h"
 #include <charconv>
 #include <array>
 #include <ranges>
@@ -11,6 +12,7 @@ ObjParser::~ObjParser()
 
 Mesh ObjParser::Parse(std::filesystem::path file_name)
 {
+	PROFILER_ZONE("ObjParser::Parse");
 	fs.open(file_name);
 	if(!fs.is_open())
 		throw ObjParserError(ObjParserResult::BadFile, 0);
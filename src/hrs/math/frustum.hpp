@@ -0,0 +1,163 @@
+/**
+ * @file
+ *
+ * Represents the view frustum planes and the bounding volume tests against them
+ */
+
+#pragma once
+
+#include "matrix.hpp"
+#include "vector.hpp"
+#include <cmath>
+
+namespace hrs
+{
+	namespace math
+	{
+		/**
+		 * @brief The frustum_test_result enum
+		 *
+		 * Result of the bounding volume test against the frustum planes
+		 */
+		enum class frustum_test_result
+		{
+			outside,///<volume is completely outside of at least one plane
+			intersects,///<volume may cross the frustum boundary
+			inside///<volume is completely inside of all planes
+		};
+
+		/**
+		 * @brief The frustum struct
+		 * @tparam T must satisfy the floating_point concept
+		 *
+		 * Every plane is stored as (a, b, c, d) with the unit normal (a, b, c) directed into the frustum,
+		 * so the signed distance of a point p to the plane is a * p.x + b * p.y + c * p.z + d
+		 */
+		template<std::floating_point T>
+		struct frustum
+		{
+			constexpr static std::size_t PLANE_COUNT = 6;///<left, right, bottom, top, near and far planes
+			using plane_type = vector<T, 4>;///<plane type
+
+			plane_type planes[PLANE_COUNT];///<planes array
+
+			/**
+			 * @brief distance
+			 * @tparam V must satisfy the vector_concept concept
+			 * @param plane plane object
+			 * @param point point with at least three components
+			 * @return signed distance from the plane to the point
+			 */
+			template<vector_concept V>
+				requires (vector_dimension<V> >= 3)
+			constexpr static T distance(const plane_type &plane, const V &point) noexcept
+			{
+				return plane[0] * point[0] + plane[1] * point[1] + plane[2] * point[2] + plane[3];
+			}
+
+			/**
+			 * @brief test_sphere
+			 * @tparam V must satisfy the vector_concept concept
+			 * @param center center of the sphere
+			 * @param radius radius of the sphere
+			 * @return position of the sphere relative to the frustum
+			 */
+			template<vector_concept V>
+				requires (vector_dimension<V> >= 3)
+			constexpr frustum_test_result test_sphere(const V &center, T radius) const noexcept
+			{
+				frustum_test_result out_result = frustum_test_result::inside;
+				for(const auto &plane : planes)
+				{
+					T dist = distance(plane, center);
+					if(dist < -radius)
+						return frustum_test_result::outside;
+
+					if(dist < radius)
+						out_result = frustum_test_result::intersects;
+				}
+
+				return out_result;
+			}
+
+			/**
+			 * @brief test_aabb
+			 * @tparam V must satisfy the vector_concept concept
+			 * @param min minimal corner of the axis aligned box
+			 * @param max maximal corner of the axis aligned box
+			 * @return position of the box relative to the frustum
+			 *
+			 * For every plane only the corner farthest along the normal(positive vertex)
+			 * and the nearest one(negative vertex) are tested
+			 */
+			template<vector_concept V>
+				requires (vector_dimension<V> >= 3)
+			constexpr frustum_test_result test_aabb(const V &min, const V &max) const noexcept
+			{
+				frustum_test_result out_result = frustum_test_result::inside;
+				for(const auto &plane : planes)
+				{
+					vector<T, 3> positive_vertex;
+					vector<T, 3> negative_vertex;
+					for(std::size_t i = 0; i < 3; i++)
+					{
+						positive_vertex[i] = (plane[i] >= 0 ? max[i] : min[i]);
+						negative_vertex[i] = (plane[i] >= 0 ? min[i] : max[i]);
+					}
+
+					if(distance(plane, positive_vertex) < 0)
+						return frustum_test_result::outside;
+
+					if(distance(plane, negative_vertex) < 0)
+						out_result = frustum_test_result::intersects;
+				}
+
+				return out_result;
+			}
+		};
+
+		/**
+		 * @brief extract_frustum
+		 * @tparam M must satisfy the matrix_concept concept
+		 * @param m view-projection matrix
+		 * @return frustum with normalized planes
+		 *
+		 * Planes are taken from the columns of the matrix(Gribb-Hartmann method) for row-major vectors
+		 * transformed as p * m with the clip volume -w <= x <= w, -w <= y <= w, 0 <= z <= w.
+		 * The depth range is symmetric, so it fits reversed depth projections as well.
+		 * Planes are in the space of the points multiplied by m, e.g. for the model-view-projection
+		 * matrix they are in the model space of the object
+		 */
+		template<matrix_concept M>
+			requires (matrix_rows<M> == 4 && matrix_cols<M> == 4 && std::floating_point<matrix_value_type<M>>)
+		constexpr auto extract_frustum(const M &m) noexcept
+		{
+			using T = matrix_value_type<M>;
+			auto column = [&](std::size_t index) noexcept
+			{
+				return vector<T, 4>(m[0][index], m[1][index], m[2][index], m[3][index]);
+			};
+
+			vector<T, 4> x = column(0);
+			vector<T, 4> y = column(1);
+			vector<T, 4> z = column(2);
+			vector<T, 4> w = column(3);
+
+			frustum<T> out_frustum;
+			out_frustum.planes[0] = w + x;
+			out_frustum.planes[1] = w - x;
+			out_frustum.planes[2] = w + y;
+			out_frustum.planes[3] = w - y;
+			out_frustum.planes[4] = z;
+			out_frustum.planes[5] = w - z;
+			for(auto &plane : out_frustum.planes)
+			{
+				T normal_length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+				if(normal_length > 0)
+					plane *= static_cast<T>(1) / normal_length;
+			}
+
+			return out_frustum;
+		}
+	};
+};
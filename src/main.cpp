@@ -1,6 +1,7 @@
 #include "hrs/math/matrix.hpp"
 #include "hrs/math/vector.hpp"
 #include "hrs/math/quaternion.hpp"
+#include "hrs/math/frustum.hpp"
 #include <SDL2/SDL.h>
 #include <cstring>
 #include <iostream>
@@ -11,11 +12,19 @@
 #include "../sdk/stb_image/stb_image.h"
 
 #include "RendererBackend/Pipeline.hpp"
+#include "RendererBackend/CommandQueue.h"
+#include "Profiler/Profiler.h"
 
 bool is_run = true;
 constexpr inline static float NEAR = 0.1f;
 constexpr inline static float FAR = 100.0f;
 constexpr inline static float FOV = 75.0f;
+constexpr inline static std::size_t SAMPLE_COUNT = Renderer::MAX_SAMPLE_COUNT;
+//near plane is mapped to depth 1 and far plane to 0, which spreads float depth precision evenly over the distance
+constexpr inline static bool REVERSED_Z = true;
+constexpr inline static Renderer::Format DEPTH_FORMAT = Renderer::Format::DEPTH32_SFLOAT;
+//the next frame is recorded while the previous one is executed by the command queue
+constexpr inline static std::size_t FRAMES_IN_FLIGHT = 2;
 
 auto view_rotate = hrs::math::glsl::std430::mat4x4::identity();
 auto view_translate = hrs::math::glsl::std430::mat4x4::identity();
@@ -29,17 +38,32 @@ struct ShaderData
 
 struct RendererObjects
 {
-	Renderer::Image color_image;
+	//every frame in flight has its own command buffer and resolved image which is copied to the window surface.
+	//Multisample and depth images are shared, since the queue executes frames one by one
+	Renderer::Image color_images[FRAMES_IN_FLIGHT];
+	Renderer::Image multisample_color_image;
 	Renderer::Image depth_image;
 	Renderer::Framebuffer framebuffer;
 	Renderer::Viewport viewport;
+	Renderer::CommandBuffer command_buffers[FRAMES_IN_FLIGHT];
+	Renderer::Fence fences[FRAMES_IN_FLIGHT];
 } renderer_objects;
 
+//images and command buffers may be changed only when no frame is executed
+void WaitFrames()
+{
+	for(const auto &fence : renderer_objects.fences)
+		fence.Wait();
+}
+
 Renderer::State pipeline_state(Renderer::RasterizationTopology::Line,
 							   true,
 							   renderer_objects.viewport,
 							   Renderer::CullSide::Back,
-							   Renderer::CullOrder::ClockWise);
+							   Renderer::CullOrder::ClockWise,
+							   Renderer::State::DEFAULT_GUARD_BAND,
+							   true,
+							   (REVERSED_Z ? Renderer::CompareOp::GreaterOrEqual : Renderer::CompareOp::LessOrEqual));
 
 
 Renderer::Format SurfaceFormatToRendererFormat(SDL_PixelFormatEnum surface_format)
@@ -94,9 +118,17 @@ hrs::math::glsl::std430::mat4x4 Perspective(float fov, float aspect, float near,
 	hrs::math::glsl::std430::mat4x4 out_mat;
 	out_mat[0][0] = near / right;
 	out_mat[1][1] = near / top;
-	out_mat[2][2] = -(far) / (near - far);
 	out_mat[2][3] = 1;
-	out_mat[3][2] = (far * near) / (near - far);
+	if(REVERSED_Z)
+	{
+		out_mat[2][2] = near / (near - far);
+		out_mat[3][2] = (far * near) / (far - near);
+	}
+	else
+	{
+		out_mat[2][2] = -(far) / (near - far);
+		out_mat[3][2] = (far * near) / (near - far);
+	}
 
 	return out_mat;
 }
@@ -134,6 +166,11 @@ void SDLEventPoll(SDL_Window *window, SDL_Surface *&surface)
 					case SDLK_f:
 						//polygon_mode = (polygon_mode == GL_LINE ? GL_FILL : GL_LINE);
 						break;
+					case SDLK_p:
+						WaitFrames();
+						if(PROFILER_ENABLED && !Profiler::WriteChromeTrace("trace.json"))
+							std::cout<<"Failed to write trace.json"<<std::endl;
+						break;
 				}
 				break;
 			case SDL_MOUSEMOTION:
@@ -171,14 +208,22 @@ void SDLEventPoll(SDL_Window *window, SDL_Surface *&surface)
 										NEAR,
 										FAR);
 
+						WaitFrames();
 						surface = SDL_GetWindowSurface(window);
-						renderer_objects.color_image.Resize(ev.window.data1,
-															ev.window.data2,
-															SurfaceFormatToRendererFormat(static_cast<SDL_PixelFormatEnum>(surface->format->format)));
+						for(auto &color_image : renderer_objects.color_images)
+							color_image.Resize(ev.window.data1,
+											   ev.window.data2,
+											   SurfaceFormatToRendererFormat(static_cast<SDL_PixelFormatEnum>(surface->format->format)));
+
+						renderer_objects.multisample_color_image.Resize(ev.window.data1,
+																		ev.window.data2,
+																		renderer_objects.color_images[0].GetFormat(),
+																		SAMPLE_COUNT);
 
 						renderer_objects.depth_image.Resize(ev.window.data1,
 															ev.window.data2,
-															Renderer::Format::DEPTH32_SFLOAT);
+															DEPTH_FORMAT,
+															SAMPLE_COUNT);
 
 						renderer_objects.viewport = Renderer::Viewport(ev.window.data1,
 																	   ev.window.data2,
@@ -295,12 +340,14 @@ int main()
 
 	int w, h;
 	SDL_GetWindowSize(window, &w, &h);
-	renderer_objects.color_image.Resize(w,
-										h,
-										SurfaceFormatToRendererFormat(static_cast<SDL_PixelFormatEnum>(surface->format->format)));
-
-	renderer_objects.depth_image.Resize(w, h, Renderer::Format::DEPTH32_SFLOAT);
-	Renderer::Image * color_images[] = {&renderer_objects.color_image};
+	for(auto &color_image : renderer_objects.color_images)
+		color_image.Resize(w,
+						   h,
+						   SurfaceFormatToRendererFormat(static_cast<SDL_PixelFormatEnum>(surface->format->format)));
+
+	renderer_objects.multisample_color_image.Resize(w, h, renderer_objects.color_images[0].GetFormat(), SAMPLE_COUNT);
+	renderer_objects.depth_image.Resize(w, h, DEPTH_FORMAT, SAMPLE_COUNT);
+	Renderer::Image * color_images[] = {&renderer_objects.multisample_color_image};
 	renderer_objects.framebuffer = Renderer::Framebuffer(color_images, &renderer_objects.depth_image);
 	renderer_objects.viewport = Renderer::Viewport(w, h, 0, 0, 0, 1);
 
@@ -349,7 +396,9 @@ int main()
 	};
 
 	auto vertex_shader = [](std::uint32_t vertex_index,
+							std::uint32_t instance_index,
 							const std::byte *vertex_input,
+							const std::byte *instance_input,
 							VertexShaderOutput &vertex_output,
 							ShaderData &shader_data) -> hrs::math::glsl::vec4
 	{
@@ -365,6 +414,7 @@ int main()
 	};
 
 	auto fragment_shader = [](const VertexShaderOutput &vertex_output,
+							  const Renderer::FragmentDerivatives<VertexShaderOutput> &derivatives,
 							  const hrs::math::vector<std::int64_t, 2> &frag_position,
 							  float frag_depth,
 							  Renderer::FragmentOutput<1> &fragment_output,
@@ -376,9 +426,14 @@ int main()
 		fragment_output.attachments[0][3] = 0;
 	};
 
-	Renderer::Pipeline<VertexShaderOutput, 1, ShaderData> pipeline(sizeof(VertexData),
-																   vertex_shader,
-																   fragment_shader);
+	Renderer::ThreadPool thread_pool;
+	auto pipeline = Renderer::MakeStaticPipeline<VertexShaderOutput, 1, ShaderData>(sizeof(VertexData),
+																					 vertex_shader,
+																					 fragment_shader,
+																					 Renderer::FragmentShaderFlags::None,
+																					 &thread_pool);
+
+	Renderer::CommandQueue command_queue;
 
 	ObjParser obj_parser;
 	MeshVertexIndexData mesh_data;
@@ -408,44 +463,117 @@ int main()
 
 	shader_data.model_matrix[3][2] += 4.f;
 	pipeline_state.viewport = renderer_objects.viewport;
-	while(is_run)
+	PROFILER_THREAD_NAME("Main");
+	for(std::size_t frame_index = 0; is_run; frame_index++)
 	{
+		PROFILER_ZONE("Frame");
 		SDLEventPoll(window, surface);
 		HandleMovement();
 
+		//the buffer of this slot was used two frames ago, its frame is already presented
+		std::size_t slot = frame_index % FRAMES_IN_FLIGHT;
+		Renderer::CommandBuffer &command_buffer = renderer_objects.command_buffers[slot];
+		renderer_objects.fences[slot].Wait();
+
 		shader_data.view_matrix = view_translate * view_rotate.transpose();
 
 		const Renderer::ClearValue clear_value(hrs::math::glsl::vec4(0.33f, 0.33f, 0.33f, 0));
-		renderer_objects.framebuffer.ClearImage(clear_value, 0);
-		renderer_objects.framebuffer.ClearDepthImage(1.0f);
-
+		command_buffer.Reset();
+		command_buffer.ClearImage(clear_value, 0);
+		command_buffer.ClearDepthImage(REVERSED_Z ? 0.0f : 1.0f);
+		command_buffer.SetState(pipeline_state);
+
+		//planes are in the model space, so part bounds are tested without transformation
+		const auto frustum = hrs::math::extract_frustum(shader_data.model_matrix *
+														shader_data.view_matrix *
+														shader_data.projection_matrix);
+		//view matrix is translate * rotate^T and the model matrix only translates, so the camera
+		//is at -(view translation + model translation) in the model space.
+		//Triangles facing the camera are clockwise on the screen(view z goes forward, screen y goes down)
+		Renderer::MeshletCullData meshlet_cull_data{.frustum = frustum,
+													.camera_position = hrs::math::glsl::vec3(-view_translate[3][0] - shader_data.model_matrix[3][0],
+																							 -view_translate[3][1] - shader_data.model_matrix[3][1],
+																							 -view_translate[3][2] - shader_data.model_matrix[3][2]),
+													.facing_order = Renderer::CullOrder::ClockWise};
+		Renderer::State part_state = pipeline_state;
 		for(const auto &part : render_mesh.GetParts())
 		{
-			pipeline.DrawIndexed(renderer_objects.framebuffer,
-								 render_mesh.GetVertexData().data(),
-								 render_mesh.GetIndexData().data() + part.offset,
-								 part.count,
-								 pipeline_state,
-								 shader_data);
+			//sphere test is cheaper, the box is tested only if the sphere crosses the boundary
+			hrs::math::frustum_test_result visibility = frustum.test_sphere(part.sphere_center, part.sphere_radius);
+			if(visibility == hrs::math::frustum_test_result::intersects)
+				visibility = frustum.test_aabb(part.aabb_min, part.aabb_max);
+
+			if(visibility == hrs::math::frustum_test_result::outside)
+				continue;
+
+			//vertices of parts inside of the frustum are inside of the clip volume
+			bool clipping_enable = (visibility != hrs::math::frustum_test_result::inside);
+			if(part_state.clipping_enable != clipping_enable)
+			{
+				part_state.clipping_enable = clipping_enable;
+				command_buffer.SetState(part_state);
+			}
+
+			//wireframe draws every shared edge once, edges are skipped only if all of their faces are culled
+			if(pipeline_state.topology == Renderer::RasterizationTopology::Line)
+				command_buffer.DrawIndexedLines(pipeline,
+												render_mesh.GetVertexData().data(),
+												render_mesh.GetEdgeIndexData().data() + part.edge_offset,
+												part.edge_count,
+												Renderer::LineFaceData{.index_data = render_mesh.GetIndexData().data() + part.offset,
+																	   .faces = render_mesh.GetEdgeFaceData().data() + part.edge_offset},
+												shader_data);
+			else
+				command_buffer.DrawIndexedMeshlets(pipeline,
+												   render_mesh.GetVertexData().data(),
+												   render_mesh.GetIndexData().data() + part.offset,
+												   render_mesh.GetMeshletData().data() + part.meshlet_offset,
+												   part.meshlet_count,
+												   meshlet_cull_data,
+												   shader_data);
 		}
 
+		command_buffer.ResolveImage(0, renderer_objects.color_images[slot]);
+		renderer_objects.fences[slot] = command_queue.Submit(command_buffer, renderer_objects.framebuffer);
+
+		//the previous frame was executed while this one was recorded, it is presented after it is finished
+		if(frame_index == 0)
+			continue;
+
+		std::size_t present_slot = (frame_index + FRAMES_IN_FLIGHT - 1) % FRAMES_IN_FLIGHT;
+		{
+			PROFILER_ZONE("WaitFence");
+			renderer_objects.fences[present_slot].Wait();
+		}
+
+		const Renderer::Image &present_image = renderer_objects.color_images[present_slot];
+
 		int lock_res = SDL_LockSurface(surface);
 		if(lock_res)
 		{
 			std::cout<<SDL_GetError()<<std::endl;
+			WaitFrames();
 			return 1;
 		}
 
-		std::memcpy(surface->pixels,
-					renderer_objects.color_image.GetMappedPtr(),
-					renderer_objects.color_image.GetWidth() * renderer_objects.color_image.GetHeight() * 4);
+		{
+			PROFILER_ZONE("SurfaceCopy");
+			std::memcpy(surface->pixels,
+						present_image.GetMappedPtr(),
+						present_image.GetWidth() * present_image.GetHeight() * 4);
+		}
 
 		SDL_UnlockSurface(surface);
 
-		SDL_UpdateWindowSurface(window);
+		{
+			PROFILER_ZONE("UpdateWindowSurface");
+			SDL_UpdateWindowSurface(window);
+		}
 #warning RASTERIZATION width - 1 and height - 1!!!
 	}
 
+	//submitted frames reference the mesh which is destroyed before the queue
+	WaitFrames();
 	SDL_DestroyWindow(window);
 	SDL_Quit();
 